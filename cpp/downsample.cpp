@@ -77,7 +77,8 @@ SparseMatrix compute_overlap_matrix(
         matrices.emplace_back(output.overlap_matrix(image));
     }
 
-    SparseMatrix total = hstack(matrices);
+    // Rows are detector pixels, so the exposures are stacked vertically
+    SparseMatrix total = vstack(matrices);
     return total;
 }
 
@@ -27,6 +27,9 @@ namespace Astar {
 
         friend struct fmt::formatter<Box>;
     };
+
+    /** Length of the intersection of two closed intervals, 0 if they are disjoint **/
+    real interval_overlap(pair<real> a, pair<real> b);
 }
 
 template<>
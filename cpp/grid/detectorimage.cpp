@@ -26,17 +26,39 @@ namespace Astar {
     }
 
     /**
-     * Load a detector image from a BMP file (quick and easy, only minimal error checking, requires 8bpp greyscale)
+     * Load a detector image from a BMP file (8, 16, 24 or 32 bpp, colour is converted to grey)
      * @param centre            Position of the image centre in world coordinates
      * @param physical_size     Physical dimensions of the image (w × h)
      * @param rotation          Rotation of the image (radians)
      * @param pixfrac           Fill factor of pixels (horizontal, vertical)
-     * @param filename          Filename to load the pixels from (8-bit BMP)
+     * @param filename          Filename to load the pixels from
      */
     DetectorImage::DetectorImage(Point centre, pair<real> physical_size, real rotation, pair<real> pixfrac,
                                  const std::string & filename):
-            AbstractGrid(read_bitmap_header(filename)),
-            PlacedGrid(centre, read_bitmap_header(filename), physical_size, rotation, pixfrac),
-            Image(filename)
+            DetectorImage(centre, physical_size, rotation, pixfrac, Bitmap(filename))
     { }
+
+    DetectorImage::DetectorImage(Point centre, pair<real> physical_size, real rotation, pair<real> pixfrac,
+                                 const Bitmap & bitmap):
+            AbstractGrid(bitmap.size()),
+            PlacedGrid(centre, bitmap.size(), physical_size, rotation, pixfrac),
+            Image(bitmap)
+    { }
+
+    DetectorImage::DetectorImage(const FitsFile & fits, std::size_t hdu, const WcsFrame & frame, pair<real> pixfrac):
+            DetectorImage(fits.placement(hdu, frame), pixfrac, fits, hdu)
+    { }
+
+    DetectorImage::DetectorImage(const WcsPlacement & placement, pair<real> pixfrac, const FitsFile & fits,
+                                 std::size_t hdu):
+            AbstractGrid(static_cast<int>(fits.hdu(hdu).width), static_cast<int>(fits.hdu(hdu).height)),
+            PlacedGrid(placement.centre, {static_cast<int>(fits.hdu(hdu).width), static_cast<int>(fits.hdu(hdu).height)},
+                       placement.physical_size, placement.rotation, pixfrac),
+            Image(fits, hdu)
+    { }
+
+    DetectorGeometry::DetectorGeometry(const DetectorImage & image):
+            AbstractGrid(image.size()),
+            PlacedGrid(image.centre(), image.size(), image.physical_size(), image.rotation(), image.pixfrac())
+    {}
 }
@@ -17,6 +17,18 @@ namespace Astar {
                       const Matrix & data);
         DetectorImage(Point centre, pair<real> physical_size, real rotation, pair<real> pixfrac,
                       const std::string & filename);
+        DetectorImage(Point centre, pair<real> physical_size, real rotation, pair<real> pixfrac,
+                      const Bitmap & bitmap);
+        /** Load an image HDU of a FITS file, placed in the world by its WCS **/
+        DetectorImage(const FitsFile & fits, std::size_t hdu, const WcsFrame & frame, pair<real> pixfrac = {1, 1});
+    private:
+        DetectorImage(const WcsPlacement & placement, pair<real> pixfrac, const FitsFile & fits, std::size_t hdu);
+    };
+
+    /** Placement of a DetectorImage without its pixel data, cheap to copy and to move or scale on its own **/
+    class DetectorGeometry: public PlacedGrid<DetectorGeometry> {
+    public:
+        explicit DetectorGeometry(const DetectorImage & image);
     };
 }
 
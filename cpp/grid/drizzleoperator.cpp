@@ -0,0 +1,114 @@
+#include "drizzleoperator.h"
+#include "grid/pixel/coverage.h"
+#include "utils/parallel.h"
+
+namespace Astar {
+    DrizzleOperator::DrizzleOperator(pair<int> model_size, const std::vector<DetectorImage> & exposures, int threads):
+        AbstractGrid(model_size),
+        offsets_(1, 0),
+        threads_(threads)
+    {
+        for (auto && exposure: exposures) {
+            this->geometry_.emplace_back(exposure);
+            this->data_.push_back(&exposure.data());
+            this->offsets_.push_back(this->offsets_.back() + exposure.count());
+        }
+    }
+
+    DrizzleOperator DrizzleOperator::scaled(pair<int> model_size, const std::vector<DetectorImage> & exposures,
+                                            real factor, int threads) {
+        DrizzleOperator drizzle(model_size, exposures, threads);
+        for (auto && geometry: drizzle.geometry_) {
+            geometry.scale(factor);
+            geometry.set_centre(geometry.centre() * factor);
+        }
+        return drizzle;
+    }
+
+    RealVector DrizzleOperator::forward(const RealVector & model) const {
+        if (model.size() != this->cols()) {
+            throw std::invalid_argument(fmt::format("Model vector has {} entries, expected {}", model.size(), this->cols()));
+        }
+
+        const Box clip(0, this->width(), 0, this->height());
+        RealVector out(this->rows());
+        for (std::size_t e = 0; e < this->geometry_.size(); ++e) {
+            const DetectorGeometry & image = this->geometry_[e];
+            real * const target = out.data() + this->offsets_[e];
+
+            parallel_for(0, image.height(), this->threads_, [&](int, int row_begin, int row_end) {
+                CoverageRasterizer rasterizer;
+                for (int row = row_begin; row < row_end; ++row) {
+                    for (int col = 0; col < image.width(); ++col) {
+                        real sum = 0;
+                        rasterizer.rasterize(image.world_pixel(col, row));
+                        rasterizer.for_each(clip, DetectorImage::NegligibleOverlap, [&](int x, int y, real overlap) {
+                            sum += overlap * model[this->width() * y + x];
+                        });
+                        target[image.width() * row + col] = sum;
+                    }
+                }
+            });
+        }
+        return out;
+    }
+
+    RealVector DrizzleOperator::adjoint(const RealVector & detector) const {
+        if (detector.size() != this->rows()) {
+            throw std::invalid_argument(fmt::format("Detector vector has {} entries, expected {}", detector.size(), this->rows()));
+        }
+
+        // Scatter into per-thread buffers, which are then summed in order
+        const int threads = resolve_threads(this->threads_);
+        std::vector<RealVector> buffers(threads);
+        const Box clip(0, this->width(), 0, this->height());
+        for (std::size_t e = 0; e < this->geometry_.size(); ++e) {
+            const DetectorGeometry & image = this->geometry_[e];
+            const real * const source = detector.data() + this->offsets_[e];
+
+            parallel_for(0, image.height(), threads, [&](int thread, int row_begin, int row_end) {
+                RealVector & buffer = buffers[thread];
+                if (buffer.size() == 0) {
+                    buffer.setZero(this->cols());
+                }
+                CoverageRasterizer rasterizer;
+                for (int row = row_begin; row < row_end; ++row) {
+                    for (int col = 0; col < image.width(); ++col) {
+                        const real value = source[image.width() * row + col];
+                        rasterizer.rasterize(image.world_pixel(col, row));
+                        rasterizer.for_each(clip, DetectorImage::NegligibleOverlap, [&](int x, int y, real overlap) {
+                            buffer[this->width() * y + x] += overlap * value;
+                        });
+                    }
+                }
+            });
+        }
+
+        RealVector out = RealVector::Zero(this->cols());
+        for (auto && buffer: buffers) {
+            if (buffer.size() > 0) {
+                out += buffer;
+            }
+        }
+        return out;
+    }
+
+    RealVector DrizzleOperator::observations() const {
+        RealVector out(this->rows());
+        for (std::size_t e = 0; e < this->data_.size(); ++e) {
+            const Matrix & data = *this->data_[e];
+            out.segment(this->offsets_[e], data.size()) = data.reshaped<Eigen::RowMajor>().cast<real>();
+        }
+        return out;
+    }
+
+    ModelImage DrizzleOperator::as_image(const RealVector & model) const {
+        ModelImage image(this->size());
+        image.data() = model.reshaped<Eigen::RowMajor>(this->height(), this->width()).cast<storage>();
+        return image;
+    }
+
+    RealVector DrizzleOperator::as_vector(const ModelImage & image) const {
+        return image.data().reshaped<Eigen::RowMajor>().cast<real>();
+    }
+}
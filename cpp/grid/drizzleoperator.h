@@ -0,0 +1,128 @@
+#ifndef ANASTASIS_CPP_DRIZZLEOPERATOR_H
+#define ANASTASIS_CPP_DRIZZLEOPERATOR_H
+
+#include <vector>
+
+#include "utils/eigen.h"
+#include "grid/detectorimage.h"
+#include "grid/modelimage.h"
+
+namespace Astar {
+    /** Matrix-free overlap operator A of a set of exposures, the same matrix that overlap_matrix builds
+     *  and stacks vertically, without ever storing its nonzeros:
+     *
+     *      A(pixel, cell) = overlap of the world pixel with the unit model cell
+     *
+     *  Model vectors are indexed as w * y + x, detector vectors as offset(exposure) + width * row + col.
+     *  The forward product (blot) computes every detector pixel independently from its own world pixel.
+     *  The adjoint (an unnormalised drizzle) scatters the detector rows of every thread into its own model-sized
+     *  buffer, and the buffers are summed in order. Nothing but the exposures and the offsets is kept between
+     *  products, so memory is linear in the number of pixels, never in the number of overlaps.
+     *  Both rasterize the pixels with the same CoverageRasterizer as ModelImage::overlap_matrix, so the matrix-free
+     *  and the assembled (or cached) systems are the same, up to the precision of `storage` in which
+     *  the assembled matrix keeps its values. The adjoint is exact up to the order of summation.
+     *
+     *  Only the placements of the exposures are copied, their pixel data are referenced and must outlive the operator.
+     */
+    class DrizzleOperator: public virtual AbstractGrid {
+    private:
+        std::vector<DetectorGeometry> geometry_;
+        std::vector<const Matrix *> data_;
+        std::vector<Eigen::Index> offsets_;
+        int threads_;
+    public:
+        DrizzleOperator(pair<int> model_size, const std::vector<DetectorImage> & exposures, int threads = 1);
+
+        /** Operator of the same exposures in a world scaled by `factor` about its origin (centres and physical sizes
+         *  multiplied by it), for a coarser model with cells 1 / factor times as large. Shares the pixel data. **/
+        static DrizzleOperator scaled(pair<int> model_size, const std::vector<DetectorImage> & exposures, real factor,
+                                      int threads = 1);
+
+        /** Total number of detector pixels over all exposures **/
+        [[nodiscard]] Eigen::Index rows() const { return this->offsets_.back(); }
+        /** Number of model cells **/
+        [[nodiscard]] int cols() const { return this->count(); }
+        [[nodiscard]] Eigen::Index offset(std::size_t exposure) const { return this->offsets_[exposure]; }
+        [[nodiscard]] const DetectorGeometry & geometry(std::size_t exposure) const { return this->geometry_[exposure]; }
+        [[nodiscard]] int threads() const { return this->threads_; }
+
+        /** Blot: project a model onto all exposures, out = A * model **/
+        [[nodiscard]] RealVector forward(const RealVector & model) const;
+        /** Unnormalised drizzle, out = A^T * detector **/
+        [[nodiscard]] RealVector adjoint(const RealVector & detector) const;
+
+        /** Values of all exposures stacked into a single detector vector **/
+        [[nodiscard]] RealVector observations() const;
+        /** Model vector as an image and back **/
+        [[nodiscard]] ModelImage as_image(const RealVector & model) const;
+        [[nodiscard]] RealVector as_vector(const ModelImage & image) const;
+    };
+
+    class NormalOperator;
+}
+
+namespace Eigen::internal {
+    template<>
+    struct traits<Astar::NormalOperator>: public Eigen::internal::traits<Eigen::SparseMatrix<::real>> {};
+}
+
+namespace Astar {
+    /** Damped normal operator A^T A + damping * I of a DrizzleOperator, symmetric positive (semi)definite.
+     *  Exposes just enough of the Eigen interface to be used as the matrix of Eigen's iterative solvers:
+     *
+     *      const NormalOperator normal(A, damping);
+     *      Eigen::ConjugateGradient<NormalOperator, Eigen::Lower | Eigen::Upper, Eigen::IdentityPreconditioner> cg;
+     *      cg.compute(normal);
+     *      RealVector model = cg.solve(A.adjoint(A.observations()));
+     *
+     *  The solver keeps a reference to the operator, so it must not be a temporary.
+     */
+    class NormalOperator: public Eigen::EigenBase<NormalOperator> {
+    private:
+        const DrizzleOperator * operator_;
+        real damping_;
+    public:
+        typedef real Scalar;
+        typedef real RealScalar;
+        typedef int StorageIndex;
+        enum {
+            ColsAtCompileTime = Eigen::Dynamic,
+            MaxColsAtCompileTime = Eigen::Dynamic,
+            IsRowMajor = false
+        };
+
+        explicit NormalOperator(const DrizzleOperator & drizzle, real damping = 0):
+            operator_(&drizzle),
+            damping_(damping)
+        {}
+
+        [[nodiscard]] Eigen::Index rows() const { return this->operator_->cols(); }
+        [[nodiscard]] Eigen::Index cols() const { return this->operator_->cols(); }
+        [[nodiscard]] real damping() const { return this->damping_; }
+
+        [[nodiscard]] RealVector apply(const RealVector & model) const {
+            return this->operator_->adjoint(this->operator_->forward(model)) + this->damping_ * model;
+        }
+
+        template<class Rhs>
+        Eigen::Product<NormalOperator, Rhs, Eigen::AliasFreeProduct> operator*(const Eigen::MatrixBase<Rhs> & x) const {
+            return Eigen::Product<NormalOperator, Rhs, Eigen::AliasFreeProduct>(*this, x.derived());
+        }
+    };
+}
+
+namespace Eigen::internal {
+    template<class Rhs>
+    struct generic_product_impl<Astar::NormalOperator, Rhs, SparseShape, DenseShape, GemvProduct>:
+        generic_product_impl_base<Astar::NormalOperator, Rhs, generic_product_impl<Astar::NormalOperator, Rhs>>
+    {
+        typedef typename Product<Astar::NormalOperator, Rhs>::Scalar Scalar;
+
+        template<class Dest>
+        static void scaleAndAddTo(Dest & dst, const Astar::NormalOperator & lhs, const Rhs & rhs, const Scalar & alpha) {
+            dst.noalias() += alpha * lhs.apply(rhs);
+        }
+    };
+}
+
+#endif //ANASTASIS_CPP_DRIZZLEOPERATOR_H
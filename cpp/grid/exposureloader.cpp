@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+#include "grid/exposureloader.h"
+#include "utils/parallel.h"
+
+namespace Astar {
+    DetectorImage Exposure::load() const {
+        std::string extension = std::filesystem::path(this->filename).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        if (extension == ".bmp") {
+            return {this->centre, this->physical_size, this->rotation, this->pixfrac, Bitmap(this->filename)};
+        } else if (extension == ".npy") {
+            const NpyArray array(this->filename);
+            DetectorImage image(this->centre, this->physical_size, this->rotation, this->pixfrac,
+                                pair<int>(array.cols(), array.rows()));
+            array.copy_to(image.data().data());
+            return image;
+        } else if ((extension == ".fits") || (extension == ".fit") || (extension == ".fts")) {
+            const FitsFile fits(this->filename);
+            const std::size_t hdu = fits.first_image();
+            DetectorImage image(this->centre, this->physical_size, this->rotation, this->pixfrac,
+                                pair<int>(fits.hdu(hdu).width, fits.hdu(hdu).height));
+            fits.copy_to(hdu, image.data().data());
+            return image;
+        } else {
+            throw std::invalid_argument(fmt::format("Unknown exposure format '{}' of {}", extension, this->filename));
+        }
+    }
+
+    ExposureLoader::ExposureLoader(std::vector<Exposure> exposures, int threads, std::size_t capacity):
+        ExposureLoader(std::move(exposures), [](const Exposure & exposure) { return exposure.load(); }, threads, capacity)
+    {}
+
+    ExposureLoader::ExposureLoader(std::vector<Exposure> exposures, Load load, int threads, std::size_t capacity):
+        exposures_(std::move(exposures)),
+        load_(std::move(load)),
+        capacity_(capacity)
+    {
+        if (capacity < 1) {
+            throw std::invalid_argument("Exposure loader needs room for at least one exposure");
+        }
+        const int workers = std::min(resolve_threads(threads), static_cast<int>(capacity));
+        for (int t = 0; t < workers; ++t) {
+            this->workers_.emplace_back(&ExposureLoader::work, this);
+        }
+    }
+
+    ExposureLoader::~ExposureLoader() {
+        {
+            std::lock_guard lock(this->mutex_);
+            this->stopping_ = true;
+        }
+        this->consumed_.notify_all();
+        for (auto && worker: this->workers_) {
+            worker.join();
+        }
+    }
+
+    void ExposureLoader::work() {
+        std::unique_lock lock(this->mutex_);
+        while (true) {
+            // Wait until there is room ahead of the consumer
+            this->consumed_.wait(lock, [this] {
+                return this->stopping_ || (this->claimed_ >= this->exposures_.size()) ||
+                       (this->claimed_ < this->delivered_ + this->capacity_);
+            });
+            if (this->stopping_ || (this->claimed_ >= this->exposures_.size())) {
+                return;
+            }
+            const std::size_t index = this->claimed_++;
+            lock.unlock();
+
+            const auto start = Clock::now();
+            std::optional<DetectorImage> image;
+            std::exception_ptr error;
+            try {
+                image.emplace(this->load_(this->exposures_[index]));
+            } catch (...) {
+                error = std::current_exception();
+            }
+            const std::chrono::duration<real> elapsed = Clock::now() - start;
+
+            lock.lock();
+            this->timing_.loading += elapsed.count();
+            if (error) {
+                this->failed_.emplace(index, error);
+            } else {
+                this->ready_.emplace(index, std::move(*image));
+            }
+            this->loaded_.notify_all();
+        }
+    }
+
+    std::optional<DetectorImage> ExposureLoader::next() {
+        const auto start = Clock::now();
+        std::unique_lock lock(this->mutex_);
+        if (this->handed_out_) {
+            this->timing_.computing += std::chrono::duration<real>(start - *this->handed_out_).count();
+        }
+        if (this->delivered_ >= this->exposures_.size()) {
+            this->handed_out_.reset();
+            return std::nullopt;
+        }
+
+        const std::size_t index = this->delivered_;
+        this->loaded_.wait(lock, [this, index] {
+            return this->ready_.contains(index) || this->failed_.contains(index);
+        });
+        this->timing_.waiting += std::chrono::duration<real>(Clock::now() - start).count();
+        ++this->delivered_;
+
+        if (auto failure = this->failed_.extract(index)) {
+            this->handed_out_.reset();
+            lock.unlock();
+            this->consumed_.notify_all();
+            std::rethrow_exception(failure.mapped());
+        }
+
+        DetectorImage image = std::move(this->ready_.extract(index).mapped());
+        this->handed_out_ = Clock::now();
+        lock.unlock();
+        this->consumed_.notify_all();
+        return image;
+    }
+
+    LoaderTiming ExposureLoader::timing() const {
+        std::lock_guard lock(this->mutex_);
+        return this->timing_;
+    }
+
+    void ExposureLoader::print_timing() const {
+        const LoaderTiming timing = this->timing();
+        fmt::print("Exposure loader: {} exposures, {} I/O threads, {:.3f} s loading, {:.3f} s waiting for I/O, "
+                   "{:.3f} s computing, {}\n",
+                   this->exposures_.size(), this->workers_.size(), timing.loading, timing.waiting, timing.computing,
+                   (timing.waiting > timing.computing) ? "I/O-bound" : "compute-bound");
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef ANASTASIS_CPP_EXPOSURELOADER_H
+#define ANASTASIS_CPP_EXPOSURELOADER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grid/detectorimage.h"
+
+namespace Astar {
+    /** An exposure that is not loaded yet: a BMP, NPY or FITS file and its placement in the world **/
+    struct Exposure {
+        std::string filename;
+        Point centre;
+        pair<real> physical_size;
+        real rotation = 0;
+        pair<real> pixfrac = {1, 1};
+
+        /** Read the file, the format is chosen by its extension (.bmp, .npy, .fits, .fit or .fts) **/
+        [[nodiscard]] DetectorImage load() const;
+    };
+
+    /** Where the time of a pipelined run went, in seconds **/
+    struct LoaderTiming {
+        real loading = 0;           // Spent reading and decoding files, summed over all I/O threads
+        real waiting = 0;           // Spent by the consumer waiting for the next exposure
+        real computing = 0;         // Spent by the consumer between receiving an exposure and asking for the next
+    };
+
+    /** Loads exposures in background threads while the previous ones are being processed, and hands them out
+     *  strictly in order. At most `capacity` exposures are loaded ahead of the consumer, so no more than
+     *  capacity + 1 images are in memory at any time, however many exposures there are.
+     *
+     *  Failures to load an exposure are rethrown by next() when that exposure is due.
+     */
+    class ExposureLoader {
+    public:
+        typedef std::function<DetectorImage(const Exposure &)> Load;
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        std::vector<Exposure> exposures_;
+        Load load_;
+        std::size_t capacity_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable loaded_;        // An exposure is ready or has failed
+        std::condition_variable consumed_;      // An exposure was handed out, so there is room for another one
+        std::map<std::size_t, DetectorImage> ready_;
+        std::map<std::size_t, std::exception_ptr> failed_;
+        std::size_t claimed_ = 0;               // Next exposure to be taken by an I/O thread
+        std::size_t delivered_ = 0;             // Next exposure to be handed out
+        bool stopping_ = false;
+
+        LoaderTiming timing_;
+        std::optional<Clock::time_point> handed_out_;
+
+        std::vector<std::thread> workers_;
+
+        void work();
+    public:
+        explicit ExposureLoader(std::vector<Exposure> exposures, int threads = 1, std::size_t capacity = 2);
+        /** Load every exposure by a function of its own instead of reading its file **/
+        ExposureLoader(std::vector<Exposure> exposures, Load load, int threads = 1, std::size_t capacity = 2);
+        ~ExposureLoader();
+
+        ExposureLoader(const ExposureLoader & other) = delete;
+        ExposureLoader & operator=(const ExposureLoader & other) = delete;
+
+        /** Next exposure in order, waiting for it if necessary, or nothing once all have been handed out **/
+        [[nodiscard]] std::optional<DetectorImage> next();
+
+        [[nodiscard]] std::size_t count() const { return this->exposures_.size(); }
+        [[nodiscard]] std::size_t capacity() const { return this->capacity_; }
+        [[nodiscard]] LoaderTiming timing() const;
+        /** Print where the time went and which side was the bottleneck **/
+        void print_timing() const;
+    };
+}
+
+#endif //ANASTASIS_CPP_EXPOSURELOADER_H
@@ -8,32 +8,11 @@
 #include "types/types.h"
 #include "utils/functions.h"
 #include "utils/eigen.h"
+#include "utils/bitmap.h"
+#include "utils/npy.h"
+#include "utils/fits.h"
 #include "abstractgrid.h"
 
-#pragma pack(push,2)
-typedef struct tagBITMAPHEADER {
-    unsigned short  biHeader = 0x4D42;
-    unsigned int    biSize = 0;
-    unsigned short  biReservedCrap1 = 0;
-    unsigned short  biReservedCrap2 = 0;
-    unsigned int    biOffset = 1078;
-} BITMAPHEADER;
-
-typedef struct tagBITMAPINFOHEADER {
-    unsigned int    biSize = 40;
-    int             biWidth = 0;
-    int             biHeight = 0;
-    short           biPlanes = 1;
-    short           biBitCount = 8;
-    unsigned int    biCompression = 0;
-    unsigned int    biSizeImage = 0;
-    int             biXPelsPerMeter = 2835;
-    int             biYPelsPerMeter = 2835;
-    unsigned int    biClrUsed = 0;
-    unsigned int    biClrImportant = 0;
-} BITMAPINFOHEADER;
-#pragma pack(pop)
-
 
 namespace Astar {
     /** An Image is an abstract grid with no placement, but contains a piece of data at every pixel.
@@ -47,29 +26,32 @@ namespace Astar {
     protected:
         Matrix data_;
 
-        static pair<int> read_bitmap_header(const std::string & filename);
         Derived map(const std::function<real(real)> & function);
 
         /** Apply a parameterless function to every pixel (constant, random, ...) **/
         Derived & map_in_place(const std::function<real()> & function);
         /** Apply a R -> R function to every pixel **/
-        Derived & map_in_place(const std::function<real(real &)> & function);
+        Derived & map_in_place(const std::function<real(storage &)> & function);
         /** Apply a R -> R function to every pixel depending on pixel coordinates and current value **/
-        Derived & map_in_place(const std::function<real(int, int, real &)> & function);
+        Derived & map_in_place(const std::function<real(int, int, storage &)> & function);
 
         real map_reduce(const std::function<real(real)> & map,
                         const std::function<real(real, real)> & reduce = std::plus<>(),
                         real init = 0) const;
+
+        void write_data(std::ostream & out) const;
     public:
         explicit Image(int width, int height);
         explicit Image(pair<int> size);
         explicit Image(const Matrix & data);
         explicit Image(const std::string & filename);
+        explicit Image(const Bitmap & bitmap);
+        Image(const FitsFile & fits, std::size_t hdu);
 
         [[nodiscard]] Matrix & data() { return this->data_; }
         [[nodiscard]] const Matrix & data() const { return this->data_; }
         [[nodiscard]] inline real operator[](int x, int y) const { return this->data_(y, x); };
-        [[nodiscard]] inline real & operator[](int x, int y) { return this->data_(y, x); };
+        [[nodiscard]] inline storage & operator[](int x, int y) { return this->data_(y, x); };
 
         Derived & fill(real value);
 
@@ -86,7 +68,11 @@ namespace Astar {
         Derived & operator/=(real value);
 
         void save_raw(const std::string & filename) const;
-        void save_npy(const std::string & filename) const;
+        void save_npy(const std::string & filename, bool fortran_order = false) const;
+        /** Replace the values with those of an .npy file of the same shape, of any supported type and order **/
+        Derived & load_npy(const std::string & filename);
+        /** Save as the primary HDU of a FITS file, with any extra header cards (see fits_card) **/
+        void save_fits(const std::string & filename, const std::vector<std::string> & cards = {}) const;
         void save_bmp(const std::string & filename) const;
 
         [[nodiscard]] real maximum() const;
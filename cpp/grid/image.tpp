@@ -1,6 +1,10 @@
 #ifndef IMAGE_TPP
 #define IMAGE_TPP
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
 #include "image.h"
 
 #define FMT_HEADER_ONLY
@@ -10,14 +14,8 @@ namespace Astar {
     template<class Derived>
     Image<Derived>::Image(int width, int height):
         AbstractGrid(width, height),
-        data_(height, width)
-    {
-        for (int row = 0; row < this->height(); ++row) {
-            for (int col = 0; col < this->width(); ++col) {
-                this->data_(row, col) = 0;
-            }
-        }
-    }
+        data_(Matrix::Zero(height, width))
+    {}
 
     template<class Derived>
     Image<Derived>::Image(pair<int> size):
@@ -32,60 +30,25 @@ namespace Astar {
 
     template<class Derived>
     Image<Derived>::Image(const std::string & filename):
-        AbstractGrid(read_bitmap_header(filename))
-    {
-        std::ifstream bitmap_file;
-        unsigned short planes, bpp;
-        unsigned char value;
-        int offset;
-        int width = this->width();
-        int height = this->height();
-
-        bitmap_file.open(filename);
-        bitmap_file.seekg(10, std::ios::beg);
-        bitmap_file.read(reinterpret_cast<char *>(&offset), 4);
-        bitmap_file.seekg(12, std::ios::cur);
-        bitmap_file.read(reinterpret_cast<char *>(&planes), 2);
-        if (planes != 0x0001) {
-            throw std::runtime_error(fmt::format("Invalid number of image planes {}, must be 1", planes));
-        }
-        bitmap_file.read(reinterpret_cast<char *>(&bpp), 2);
-        if (bpp != 0x0008) {
-            throw std::runtime_error(fmt::format("Invalid BPP {}, must be 8", bpp));
-        }
-        bitmap_file.seekg(offset, std::ios::beg);
+        Image(Bitmap(filename))
+    {}
 
-        this->data_.resize(height, width);
-        for (int row = 0; row < height; ++row) {
-            for (int col = 0; col < width; ++col) {
-                bitmap_file.read(reinterpret_cast<char *>(&value), 1);
-                this->data_(row, col) = static_cast<real>(value) / 255.0;
-            }
-        }
-        bitmap_file.close();
-        fmt::print("Loaded bitmap '{}' with size {} × {}\n", filename, width, height);
+    template<class Derived>
+    Image<Derived>::Image(const Bitmap & bitmap):
+        AbstractGrid(bitmap.size()),
+        data_(bitmap.height(), bitmap.width())
+    {
+        bitmap.convert(this->data_.data());
+        fmt::print("Loaded bitmap '{}' with size {} × {}\n", bitmap.filename(), bitmap.width(), bitmap.height());
     }
 
     template<class Derived>
-    pair<int> Image<Derived>::read_bitmap_header(const std::string & filename) {
-        std::ifstream bitmap_file;
-        unsigned short header;
-        int width, height;
-
-        bitmap_file.open(filename);
-        if (!bitmap_file.is_open()) {
-            throw std::runtime_error(fmt::format("Could not open file {}", filename));
-        }
-        bitmap_file.seekg(0, std::ios::beg);
-        bitmap_file.read(reinterpret_cast<char *>(&header), 2);
-        if (header != 0x4D42) {
-            throw std::runtime_error(fmt::format("Invalid BMP magic value {:04x}", header));
-        }
-        bitmap_file.seekg(18, std::ios::beg);
-        bitmap_file.read(reinterpret_cast<char *>(&width), 4);
-        bitmap_file.read(reinterpret_cast<char *>(&height), 4);
-        bitmap_file.close();
-        return {width, height};
+    Image<Derived>::Image(const FitsFile & fits, std::size_t hdu):
+        AbstractGrid(static_cast<int>(fits.hdu(hdu).width), static_cast<int>(fits.hdu(hdu).height)),
+        data_(fits.hdu(hdu).height, fits.hdu(hdu).width)
+    {
+        fits.copy_to(hdu, this->data_.data());
+        fmt::print("Loaded HDU {} of '{}' with size {} × {}\n", hdu, fits.filename(), this->width(), this->height());
     }
 
     template<class Derived>
@@ -115,7 +78,7 @@ namespace Astar {
     }
 
     template<class Derived>
-    Derived & Image<Derived>::map_in_place(const std::function<real(real &)> & function) {
+    Derived & Image<Derived>::map_in_place(const std::function<real(storage &)> & function) {
         for (int row = 0; row < this->height(); ++row) {
             for (int col = 0; col < this->width(); ++col) {
                 function((*this)[col, row]);
@@ -125,7 +88,7 @@ namespace Astar {
     }
 
     template<class Derived>
-    Derived & Image<Derived>::map_in_place(const std::function<real(int, int, real &)> & function) {
+    Derived & Image<Derived>::map_in_place(const std::function<real(int, int, storage &)> & function) {
         for (int row = 0; row < this->height(); ++row) {
             for (int col = 0; col < this->width(); ++col) {
                 function(col, row, (*this)[col, row]);
@@ -136,13 +99,13 @@ namespace Astar {
 
     template<class Derived>
     Derived & Image<Derived>::operator*=(const real value) {
-        return this->map_in_place([&](real & x) { return x *= value; });
+        return this->map_in_place([&](storage & x) { return x *= value; });
     }
 
     /** Divide every pixel by `value` **/
     template<class Derived>
     Derived & Image<Derived>::operator/=(const real value) {
-        return this->map_in_place([&](real & x) { return x /= value; });
+        return this->map_in_place([&](storage & x) { return x /= value; });
     }
 
     template<class Derived>
@@ -176,52 +139,100 @@ namespace Astar {
     void Image<Derived>::save_raw(const std::string & filename) const {
         std::ofstream out;
         out.open(filename);
-        for (int row = 0; row < this->height(); ++row) {
-            for (int col = 0; col < this->width(); ++col) {
-                real value = (*this)[col, row];
-                out.write(reinterpret_cast<const char*>(&value), sizeof value);
-            }
+        this->write_data(out);
+        out.close();
+    }
+
+    /**
+     * Save the image as a numpy array, with the header and all the values written in one go each.
+     * In Fortran order the values are transposed into a column-major copy first.
+     * @param filename
+     * @param fortran_order
+     */
+    template<class Derived>
+    void Image<Derived>::save_npy(const std::string & filename, bool fortran_order) const {
+        std::ofstream out(filename, std::ios::binary);
+        const std::string header = npy_header(npy_descr(), fortran_order, this->height(), this->width());
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+        if (fortran_order) {
+            const Eigen::Matrix<storage, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> columns = this->data_;
+            out.write(reinterpret_cast<const char *>(columns.data()),
+                      static_cast<std::streamsize>(columns.size() * sizeof(storage)));
+        } else {
+            this->write_data(out);
+        }
+        if (!out) {
+            throw std::runtime_error(fmt::format("Could not write {}", filename));
         }
         out.close();
+        fmt::print("Image with size {} saved to {}\n", this->size(), filename);
     }
 
     /**
-     * Save the image to a raw file of sequential real numbers as a numpy array.
-     * Only implements the very minimum to work, feel free to extend.
+     * Load the values from a memory-mapped numpy array, copied straight into the buffer if the type and order match.
      * @param filename
      */
     template<class Derived>
-    void Image<Derived>::save_npy(const std::string & filename) const {
-        std::ofstream out;
-        out.open(filename);
-        unsigned char c = 0x93;
-        out.write(reinterpret_cast<const char *>(&c), sizeof c);
-        out.write("NUMPY", 5);
-        unsigned short d = 1;
-        out.write(reinterpret_cast<const char *>(&d), sizeof d);
-        d = 0x76;
-        out.write(reinterpret_cast<const char *>(&d), sizeof d);
-        const std::string desc = fmt::format("{{'descr': '<f{}', 'fortran_order': False, 'shape': ({}, {})}}",
-                                             sizeof(real), this->height(), this->width());
-        out.write(desc.c_str(), desc.length());
-        c = 0x20;
-        // The length of the header must be a multiple of 64, so it is padded with spaces
-        for (int i = 10 + desc.length(); i % 64 != 63; ++i) {
-            out.write(reinterpret_cast<const char *>(&c), sizeof c);
+    Derived & Image<Derived>::load_npy(const std::string & filename) {
+        const NpyArray array(filename);
+        if ((array.rows() != this->height()) || (array.cols() != this->width())) {
+            throw std::runtime_error(fmt::format("Array in {} has shape ({}, {}), but the image is {}×{}",
+                                                 filename, array.rows(), array.cols(), this->width(), this->height()));
         }
-        c = 0x0A;
-        out.write(reinterpret_cast<const char*>(&c), sizeof c);
+        array.copy_to(this->data_.data());
+        return static_cast<Derived &>(*this);
+    }
 
-        for (int row = 0; row < this->height(); ++row) {
-            for (int col = 0; col < this->width(); ++col) {
-                real value = (*this)[col, row];
-                out.write(reinterpret_cast<const char *>(&value), sizeof value);
-            }
+    /**
+     * Save the image as a FITS file with BITPIX -64 or -32 according to the storage type. The data are
+     * byte-swapped to big-endian in a copy and written in a single call, padded to whole blocks.
+     * @param filename
+     * @param cards     Additional header cards, e.g. WCS keywords
+     */
+    template<class Derived>
+    void Image<Derived>::save_fits(const std::string & filename, const std::vector<std::string> & cards) const {
+        std::vector<std::string> header = {
+            fits_card("SIMPLE", "T"),
+            fits_card("BITPIX", std::to_string(fits_bitpix())),
+            fits_card("NAXIS", "2"),
+            fits_card("NAXIS1", std::to_string(this->width())),
+            fits_card("NAXIS2", std::to_string(this->height())),
+        };
+        header.insert(header.end(), cards.begin(), cards.end());
+
+        Matrix data = this->data_;
+        if constexpr (std::endian::native == std::endian::little) {
+            typedef std::conditional_t<sizeof(storage) == 8, std::uint64_t, std::uint32_t> Word;
+            auto * words = reinterpret_cast<Word *>(data.data());
+            std::transform(words, words + data.size(), words, [](Word word) { return std::byteswap(word); });
+        }
+
+        std::ofstream out(filename, std::ios::binary);
+        const std::string text = fits_header(header);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        const std::size_t bytes = data.size() * sizeof(storage);
+        out.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(bytes));
+        const std::string padding((FitsFile::BlockSize - bytes % FitsFile::BlockSize) % FitsFile::BlockSize, '\0');
+        out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        if (!out) {
+            throw std::runtime_error(fmt::format("Could not write {}", filename));
         }
         out.close();
         fmt::print("Image with size {} saved to {}\n", this->size(), filename);
     }
 
+    /**
+     * Write the pixel values in row-major order, which is exactly how they are stored, in a single call.
+     * @param out
+     */
+    template<class Derived>
+    void Image<Derived>::write_data(std::ostream & out) const {
+        static_assert(Matrix::IsRowMajor, "Image data must be stored row-major to be written directly");
+        out.write(reinterpret_cast<const char *>(this->data_.data()),
+                  static_cast<std::streamsize>(this->data_.size() * sizeof(storage)));
+    }
+
     /**
      * Save an image to a bitmap file with BMPHEADERINFO. Crude and inefficient but gets the job done.
      * @param filename
@@ -266,9 +277,14 @@ namespace Astar {
 
     template<class Derived>
     real Image<Derived>::rms() const {
-        return std::sqrt(this->map_reduce(
-            [](real x) { return x * x; }
-        ) / static_cast<real>(this->count()));
+        CompensatedSum sum;
+        for (int row = 0; row < this->height(); ++row) {
+            for (int col = 0; col < this->width(); ++col) {
+                const real value = (*this)[col, row];
+                sum += value * value;
+            }
+        }
+        return std::sqrt(sum.value() / static_cast<real>(this->count()));
     }
 }
 
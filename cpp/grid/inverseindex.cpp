@@ -0,0 +1,48 @@
+#include <numeric>
+
+#include "inverseindex.h"
+#include "utils/parallel.h"
+
+namespace Astar {
+    InverseIndex::InverseIndex(pair<int> model_size, const DetectorImage & image, int threads):
+        AbstractGrid(model_size),
+        detector_width_(image.width()),
+        offsets_(model_size.first * model_size.second + 1, 0)
+    {
+        // Bounding boxes of all detector pixels, clipped to the model, computed in parallel
+        std::vector<Box> boxes(image.count(), Box(0, 0, 0, 0));
+        parallel_for(0, image.height(), threads, [&](int, int row_begin, int row_end) {
+            for (int row = row_begin; row < row_end; ++row) {
+                for (int col = 0; col < image.width(); ++col) {
+                    Box bounds = image.world_pixel(col, row).bounding_box();
+                    boxes[image.width() * row + col] = Box(
+                        std::max(bounds.left, 0), std::min(bounds.right, this->width()),
+                        std::max(bounds.bottom, 0), std::min(bounds.top, this->height())
+                    );
+                }
+            }
+        });
+
+        // First pass: count the candidate detector pixels of every model cell
+        for (auto && box: boxes) {
+            for (int y = box.bottom; y < box.top; ++y) {
+                for (int x = box.left; x < box.right; ++x) {
+                    ++this->offsets_[this->width() * y + x + 1];
+                }
+            }
+        }
+        std::partial_sum(this->offsets_.begin(), this->offsets_.end(), this->offsets_.begin());
+
+        // Second pass: fill them in, detector pixels are visited in row-major order so every list is sorted
+        this->pixels_.resize(this->offsets_.back());
+        std::vector<int> cursor(this->offsets_.begin(), this->offsets_.end() - 1);
+        for (int pixel = 0; pixel < static_cast<int>(boxes.size()); ++pixel) {
+            const Box & box = boxes[pixel];
+            for (int y = box.bottom; y < box.top; ++y) {
+                for (int x = box.left; x < box.right; ++x) {
+                    this->pixels_[cursor[this->width() * y + x]++] = pixel;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef ANASTASIS_CPP_INVERSEINDEX_H
+#define ANASTASIS_CPP_INVERSEINDEX_H
+
+#include <span>
+#include <vector>
+
+#include "grid/abstractgrid.h"
+#include "grid/detectorimage.h"
+
+namespace Astar {
+    /** Inverse map from the cells of a model grid to the detector pixels that might overlap them,
+     *  that is those whose world bounding box covers the cell.
+     *  Stored in compressed form: the detector pixels of cell (x, y) are found at
+     *  pixels_[offsets_[w * y + x] .. offsets_[w * y + x + 1]), encoded as width * row + col
+     *  and listed in the row-major order of the detector.
+     */
+    class InverseIndex: public virtual AbstractGrid {
+    private:
+        int detector_width_;
+        std::vector<int> offsets_;
+        std::vector<int> pixels_;
+    public:
+        InverseIndex(pair<int> model_size, const DetectorImage & image, int threads = 1);
+
+        [[nodiscard]] inline std::span<const int> operator[](int x, int y) const {
+            const int cell = this->width() * y + x;
+            return {this->pixels_.data() + this->offsets_[cell], this->pixels_.data() + this->offsets_[cell + 1]};
+        }
+
+        [[nodiscard]] inline int column(int pixel) const { return pixel % this->detector_width_; }
+        [[nodiscard]] inline int row(int pixel) const { return pixel / this->detector_width_; }
+
+        [[nodiscard]] std::size_t entries() const { return this->pixels_.size(); }
+    };
+}
+
+#endif //ANASTASIS_CPP_INVERSEINDEX_H
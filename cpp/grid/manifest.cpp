@@ -0,0 +1,100 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include "grid/manifest.h"
+
+namespace Astar {
+    namespace {
+        real parse_real(const std::string & token, const std::string & filename, int line) {
+            char * end = nullptr;
+            const real value = std::strtod(token.c_str(), &end);
+            if ((end == token.c_str()) || (*end != '\0')) {
+                throw std::runtime_error(fmt::format("{}:{}: '{}' is not a number", filename, line, token));
+            }
+            return value;
+        }
+    }
+
+    std::vector<Exposure> read_manifest(const std::string & filename) {
+        std::ifstream in(filename);
+        if (!in) {
+            throw std::runtime_error(fmt::format("Could not open manifest {}", filename));
+        }
+        const std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+
+        std::vector<Exposure> exposures;
+        std::string text;
+        for (int line = 1; std::getline(in, text); ++line) {
+            text = text.substr(0, text.find('#'));
+
+            std::vector<std::string> fields;
+            std::size_t begin = text.find_first_not_of(" \t\r");
+            while (begin != std::string::npos) {
+                const std::size_t end = text.find_first_of(" \t\r", begin);
+                fields.push_back(text.substr(begin, end - begin));
+                begin = text.find_first_not_of(" \t\r", end);
+            }
+            if (fields.empty()) {
+                continue;
+            }
+            if (fields.size() != 8) {
+                throw std::runtime_error(fmt::format("{}:{}: expected 8 fields, found {}", filename, line, fields.size()));
+            }
+
+            std::filesystem::path path(fields[0]);
+            if (path.is_relative()) {
+                path = directory / path;
+            }
+            exposures.push_back({
+                path.string(),
+                Point(parse_real(fields[1], filename, line), parse_real(fields[2], filename, line)),
+                {parse_real(fields[3], filename, line), parse_real(fields[4], filename, line)},
+                parse_real(fields[5], filename, line),
+                {parse_real(fields[6], filename, line), parse_real(fields[7], filename, line)},
+            });
+        }
+        return exposures;
+    }
+
+    void write_manifest(const std::string & filename, const std::vector<Exposure> & exposures) {
+        // Names are read relative to the directory of the manifest, so write them relative to it too
+        std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+        if (directory.empty()) {
+            directory = ".";
+        }
+
+        std::string text = "# filename centre_x centre_y physical_width physical_height rotation pixfrac_x pixfrac_y\n";
+        for (auto && exposure: exposures) {
+            std::filesystem::path path = std::filesystem::relative(exposure.filename, directory);
+            if (path.empty()) {
+                path = std::filesystem::absolute(exposure.filename);
+            }
+            text += fmt::format("{} {} {} {} {} {} {} {}\n", path.string(), exposure.centre.x, exposure.centre.y,
+                                exposure.physical_size.first, exposure.physical_size.second, exposure.rotation,
+                                exposure.pixfrac.first, exposure.pixfrac.second);
+        }
+
+        std::ofstream out(filename);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!out) {
+            throw std::runtime_error(fmt::format("Could not write manifest {}", filename));
+        }
+    }
+
+    ModelImage drizzle_manifest(const std::string & filename, pair<int> model_size, int threads, std::size_t capacity) {
+        ExposureLoader loader(read_manifest(filename), threads, capacity);
+        if (loader.count() == 0) {
+            throw std::runtime_error(fmt::format("Manifest {} lists no exposures", filename));
+        }
+        fmt::print("Streaming {} exposures from {}, at most {} loaded ahead\n", loader.count(), filename, capacity);
+
+        ModelImage model(model_size);
+        model.set_threads(threads);
+        model.naive_drizzle(loader);
+        model *= 1.0 / static_cast<real>(loader.count());
+
+        loader.print_timing();
+        return model;
+    }
+}
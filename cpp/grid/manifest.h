@@ -0,0 +1,32 @@
+#ifndef ANASTASIS_CPP_MANIFEST_H
+#define ANASTASIS_CPP_MANIFEST_H
+
+#include <string>
+#include <vector>
+
+#include "grid/exposureloader.h"
+#include "grid/modelimage.h"
+
+namespace Astar {
+    /** Read a manifest of exposures, a text file with one exposure per line:
+     *
+     *      filename centre_x centre_y physical_width physical_height rotation pixfrac_x pixfrac_y
+     *
+     *  Rotation is in radians. Fields are separated by whitespace, so file names cannot contain spaces;
+     *  relative names are taken relative to the directory of the manifest. Empty lines and everything
+     *  after '#' are ignored.
+     */
+    std::vector<Exposure> read_manifest(const std::string & filename);
+
+    /** Write a manifest, numbers with as many digits as needed to read them back exactly.
+     *  File names are written relative to the directory of the new manifest, so that it reads back the same files. **/
+    void write_manifest(const std::string & filename, const std::vector<Exposure> & exposures);
+
+    /** Naive drizzle of every exposure of a manifest onto a new model, averaged over the exposures.
+     *  Exposures are loaded by `threads` background threads at most `capacity` ahead of the drizzle,
+     *  so the memory needed does not grow with the number of exposures. **/
+    ModelImage drizzle_manifest(const std::string & filename, pair<int> model_size,
+                                int threads = 1, std::size_t capacity = 2);
+}
+
+#endif //ANASTASIS_CPP_MANIFEST_H
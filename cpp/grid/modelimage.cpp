@@ -1,6 +1,26 @@
+#include <limits>
+
 #include "modelimage.h"
+#include "grid/inverseindex.h"
+#include "grid/pixel/coverage.h"
+#include "grid/pixel/pixelbatch.h"
+#include "grid/separable.h"
+#include "utils/parallel.h"
 
 namespace Astar {
+    namespace {
+        /** The stored image itself if it already holds full precision values, otherwise the scratch matrix **/
+        template<class Data>
+        RealMatrix & accumulator(Data & data, RealMatrix & scratch) {
+            if constexpr (std::is_same_v<Data, RealMatrix>) {
+                return data;
+            } else {
+                scratch.setZero(data.rows(), data.cols());
+                return scratch;
+            }
+        }
+    }
+
     ModelImage::ModelImage(int width, int height):
         AbstractGrid(width, height),
         Image(width, height),
@@ -49,12 +69,41 @@ namespace Astar {
         return *this;
     }
 
+    ModelImage & ModelImage::naive_drizzle(ExposureLoader & loader) {
+        while (auto image = loader.next()) {
+            this->naive_drizzle(*image);
+        }
+
+        return *this;
+    }
+
+    ModelImage & ModelImage::gather_drizzle(const std::vector<DetectorImage> & images) {
+        /** Drizzle a vector of DetectorImages onto this ModelImage **/
+        for (auto && image: images) {
+            this->gather_drizzle(image);
+        }
+
+        return *this;
+    }
+
     ModelImage & ModelImage::weighted_drizzle(const std::vector<DetectorImage> & images) {
         /** Drizzle a vector of DetectorImages onto this ModelImage **/
         for (auto && image: images) {
             this->weighted_drizzle(image);
         }
 
+        return this->normalise_weights();
+    }
+
+    ModelImage & ModelImage::weighted_drizzle(ExposureLoader & loader) {
+        while (auto image = loader.next()) {
+            this->weighted_drizzle(*image);
+        }
+
+        return this->normalise_weights();
+    }
+
+    ModelImage & ModelImage::normalise_weights() {
         for (int row = 0; row < this->height(); ++row) {
             for (int col = 0; col < this->width(); ++col) {
                 if (this->variance_(row, col) == 0) {
@@ -68,162 +117,234 @@ namespace Astar {
         return *this;
     }
 
-    SparseMatrix ModelImage::overlap_matrix(const DetectorImage & image) const {
-        std::vector<Overlap4D> active_pixels;
-        // There will be about four times as many overlaps as there are model pixels
-        active_pixels.reserve(4 * image.count());
+    ModelImage & ModelImage::set_threads(int threads) {
+        this->threads_ = threads;
+        return *this;
+    }
 
-        for (int row = 0; row < image.height(); ++row) {
-            for (int col = 0; col < image.width(); ++col) {
-                const Pixel & image_pixel = image.world_pixel(col, row);
-                Box bounds = image_pixel.bounding_box(0);
+    ModelImage & ModelImage::set_deterministic(bool deterministic) {
+        this->deterministic_ = deterministic;
+        return *this;
+    }
 
-                // For every pixel potentially caught in the drizzle
-                for (int y = bounds.bottom; y < bounds.top; ++y) {
-                    if ((y < 0) || (y >= this->height())) {
-                        continue;
-                    }
-                    for (int x = bounds.left; x < bounds.right; ++x) {
-                        if ((x < 0) || (x >= this->width())) {
-                            continue;
-                        }
-                        auto && model_pixel = this->pixel(x, y);
+    template<class Callback>
+    void ModelImage::for_each_overlap(pair<int> size, const DetectorImage & image, int row_begin, int row_end,
+                                      Callback && callback) {
+        // Rather than clipping every cell of the bounding box, rasterize the exact coverage of every pixel
+        CoverageRasterizer rasterizer;
+        const Box clip(0, size.first, 0, size.second);
 
-                        // Calculate the overlap of model and data pixels
-                        real overlap = model_pixel & image_pixel;
-                        active_pixels.emplace_back(col, row, x, y, overlap);
-                    }
-                }
+        // For every pixel of the drizzling image
+        for (int row = row_begin; row < row_end; ++row) {
+            for (int col = 0; col < image.width(); ++col) {
+                rasterizer.rasterize(image.world_pixel(col, row));
+                rasterizer.for_each(clip, DetectorImage::NegligibleOverlap, [&](int x, int y, real overlap) {
+                    callback(col, row, x, y, overlap);
+                });
             }
         }
-        // Return a row-major matrix of overlaps
-
-        SparseMatrix output(image.height() * image.width(), this->height() * this->width());
-        for (auto && pixel: active_pixels) {
-            output.insert(
-                image.width() * std::get<1>(pixel) + std::get<0>(pixel),
-                image.width() * std::get<3>(pixel) + std::get<2>(pixel)
-            ) = std::get<4>(pixel);
+    }
+
+    SparseMatrix ModelImage::overlap_matrix(const DetectorImage & image) const {
+        return overlap_matrix(this->size(), image, this->threads_);
+    }
+
+    SparseMatrix ModelImage::overlap_matrix(pair<int> model_size, const DetectorImage & image, int threads) {
+        /** Overlaps of every detector pixel (rows, width * row + col) with every model cell (columns, w * y + x).
+         *  Detector pixels are visited in row-major order and the cells of each pixel in increasing order,
+         *  so the matrix is assembled directly in compressed row form: every thread fills a contiguous range
+         *  of rows into its own arrays, which are then copied to their final place. **/
+        threads = resolve_threads(threads);
+        const int model_width = model_size.first;
+        struct Block {
+            std::vector<int> columns;
+            std::vector<storage> values;
+            std::vector<int> row_sizes;
+        };
+        std::vector<Block> blocks(threads);
+
+        parallel_for(0, image.height(), threads, [&](int thread, int row_begin, int row_end) {
+            Block & block = blocks[thread];
+            // There will be about four times as many overlaps as there are model pixels
+            block.columns.reserve(4 * static_cast<std::size_t>(row_end - row_begin) * image.width());
+            block.values.reserve(block.columns.capacity());
+            block.row_sizes.assign(static_cast<std::size_t>(row_end - row_begin) * image.width(), 0);
+
+            for_each_overlap(model_size, image, row_begin, row_end, [&](int col, int row, int x, int y, real overlap) {
+                block.columns.push_back(model_width * y + x);
+                block.values.push_back(static_cast<storage>(overlap));
+                ++block.row_sizes[image.width() * (row - row_begin) + col];
+            });
+        });
+
+        std::size_t nonzeros = 0;
+        std::vector<std::size_t> starts;
+        for (auto && block: blocks) {
+            starts.push_back(nonzeros);
+            nonzeros += block.columns.size();
         }
-        output.makeCompressed();
+        if (nonzeros > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            throw std::runtime_error(fmt::format("Overlap matrix with {} nonzeros does not fit 32-bit indices", nonzeros));
+        }
+
+        SparseMatrix output(image.count(), model_width * model_size.second);
+        output.resizeNonZeros(static_cast<Eigen::Index>(nonzeros));
+        int * const outer = output.outerIndexPtr();
+        parallel_for(0, image.height(), threads, [&](int thread, int row_begin, int) {
+            const Block & block = blocks[thread];
+            std::copy(block.columns.begin(), block.columns.end(), output.innerIndexPtr() + starts[thread]);
+            std::copy(block.values.begin(), block.values.end(), output.valuePtr() + starts[thread]);
+
+            int offset = static_cast<int>(starts[thread]);
+            int * const first = outer + static_cast<std::size_t>(row_begin) * image.width();
+            for (std::size_t i = 0; i < block.row_sizes.size(); ++i) {
+                first[i] = offset;
+                offset += block.row_sizes[i];
+            }
+        });
+        outer[image.count()] = static_cast<int>(nonzeros);
         return output;
     }
 
     ModelImage & ModelImage::naive_drizzle(const DetectorImage & image) {
-        /** Drizzle a DetectorImage into this ModelImage **/
-        int total = 0;
-        int inspected = 0;
-        real sum = 0;
-
-        if ((std::abs(std::sin(image.rotation())) < 1e-10) || (std::abs(std::cos(image.rotation())) < 1e-10)) {
+        /** Drizzle a DetectorImage into this ModelImage.
+         *  With more than one thread the detector rows are split into contiguous blocks. In the default mode
+         *  every worker scatters into its own accumulation buffer and the buffers are then summed in order.
+         *  In deterministic mode the workers only record their contributions, which are then replayed
+         *  block by block, reproducing the serial order of additions (and hence its result) exactly.
+         */
+        if (image.is_orthogonal()) {
             // If the grid is aligned or rotated by right angle, we can do it much more quickly:
-            // just find the overlap of corresponding line segments in both directions and multiply.
-            for (int row = 0; row < image.height(); ++row) {
-                for (int col = 0; col < image.width(); ++col) {
-                    const Pixel & image_pixel = image.world_pixel(col, row);
-                    Box bounds = image_pixel.bounding_box();
-
-                    // For every pixel potentially caught in the drizzle
-                    for (int y = bounds.bottom; y < bounds.top; ++y) {
-                        if ((y < 0) || (y >= this->height())) {
-                            continue;
-                        }
-                        for (int x = bounds.left; x < bounds.right; ++x) {
-                            if ((x < 0) || (x >= this->width())) {
-                                continue;
-                            }
-                            auto && model_pixel = this->pixel(x, y);
-
-                            // Calculate the overlap of model and data pixels
-                            real overlap = model_pixel & image_pixel;
-                            // fmt::print("{} {} {} {}\n", model_pixel, image_pixel, overlap, (*this)[x, y]);
-                            if (overlap > DetectorImage::NegligibleOverlap) {
-                                // If not zero or negligibly small, add to the value at [x, y] the value
-                                // from source's [col, row], scaled by overlap and pixel area
-                                (*this)[x, y] += image[col, row] * overlap / image.pixel_area(col, row);
-                                ++total;
-                                sum += (*this)[x, y];
-                            }
-                            // fmt::print("{} {} × {} {} -> {}\n", x, y, row, col, overlap);
-                            inspected++;
-                        }
-                    }
+            // overlaps are products of 1D interval overlaps, so the drizzle is a separable pass
+            const RealMatrix sum = SeparableWeights(this->size(), image).apply(image.data()) / image.pixel_area(0, 0);
+            this->data_ += sum.cast<storage>();
+            return *this;
+        }
+
+        const int threads = std::min(resolve_threads(this->threads_), image.height());
+
+        // If not zero or negligibly small, add to the value at [x, y] the value
+        // from source's [col, row], scaled by overlap and pixel area
+        auto contribution = [&](int col, int row, real overlap) {
+            return image[col, row] * overlap / image.pixel_area(col, row);
+        };
+
+        // Contributions are summed in full precision: straight into the image if it is stored as real,
+        // otherwise into a temporary that is added to the stored image only at the end
+        constexpr bool direct = std::is_same_v<storage, real>;
+        RealMatrix scratch;
+        RealMatrix & sum = accumulator(this->data_, scratch);
+
+        if (threads <= 1) {
+            for_each_overlap(this->size(), image, 0, image.height(), [&](int col, int row, int x, int y, real overlap) {
+                sum(y, x) += contribution(col, row, overlap);
+            });
+            if constexpr (!direct) {
+                this->data_ += scratch.cast<storage>();
+            }
+            return *this;
+        }
+
+        if (this->deterministic_) {
+            struct Contribution {
+                int x;
+                int y;
+                real value;
+            };
+            std::vector<std::vector<Contribution>> logs(threads);
+
+            parallel_for(0, image.height(), threads, [&](int thread, int row_begin, int row_end) {
+                auto & log = logs[thread];
+                log.reserve(4 * static_cast<std::size_t>(row_end - row_begin) * image.width());
+                for_each_overlap(this->size(), image, row_begin, row_end, [&](int col, int row, int x, int y, real overlap) {
+                    log.push_back({x, y, contribution(col, row, overlap)});
+                });
+            });
+
+            for (auto && log: logs) {
+                for (auto && [x, y, value]: log) {
+                    sum(y, x) += value;
                 }
             }
         } else {
-            // For every pixel of the drizzling image
-            for (int row = 0; row < image.height(); ++row) {
-                for (int col = 0; col < image.width(); ++col) {
-                    // Find the orthogonal bounds of the pixel so that many unnecessary computations can be avoided completely
-                    const Pixel & image_pixel = image.world_pixel(col, row);
-                    Box bounds = image_pixel.bounding_box();
-
-                    // For every pixel potentially caught in the drizzle
-                    for (int y = bounds.bottom; y < bounds.top; ++y) {
-                        if ((y < 0) || (y >= this->height())) {
-                            continue;
-                        }
-                        for (int x = bounds.left; x < bounds.right; ++x) {
-                            if ((x < 0) || (x >= this->width())) {
-                                continue;
-                            }
-                            auto && model_pixel = this->pixel(x, y);
-
-                            // Calculate the overlap of model and data pixels
-                            real overlap = model_pixel & image_pixel;
-                            // fmt::print("{} {} {} {}\n", model_pixel, image_pixel, overlap, (*this)[x, y]);
-                            if (overlap > DetectorImage::NegligibleOverlap) {
-                                // If not zero or negligibly small, add to the value at [x, y] the value
-                                // from source's [col, row], scaled by overlap and pixel area
-                                (*this)[x, y] += image[col, row] * overlap / image.pixel_area(col, row);
-                                ++total;
-                                sum += (*this)[x, y];
-                            }
-                            // fmt::print("{} {} × {} {} -> {}\n", x, y, row, col, overlap);
-                            inspected++;
-                        }
-                    }
-                }
+            std::vector<RealMatrix> buffers(threads);
+
+            parallel_for(0, image.height(), threads, [&](int thread, int row_begin, int row_end) {
+                auto & buffer = buffers[thread];
+                buffer.setZero(this->height(), this->width());
+                for_each_overlap(this->size(), image, row_begin, row_end, [&](int col, int row, int x, int y, real overlap) {
+                    buffer(y, x) += contribution(col, row, overlap);
+                });
+            });
+
+            for (auto && buffer: buffers) {
+                sum += buffer;
             }
         }
+        if constexpr (!direct) {
+            this->data_ += scratch.cast<storage>();
+        }
         return *this;
     }
 
-    ModelImage & ModelImage::weighted_drizzle(const DetectorImage & image) {
-        /** Drizzle a DetectorImage into this ModelImage **/
-
-        // For every pixel of the drizzling image
-        for (int row = 0; row < image.height(); ++row) {
-            for (int col = 0; col < image.width(); ++col) {
-                const Pixel & image_pixel = image.world_pixel(col, row);
-                Box bounds = image_pixel.bounding_box(0);
-
-                for (int y = bounds.bottom; y < bounds.top; ++y) {
-                    if ((y < 0) || (y >= this->height())) {
-                        continue;
-                    }
-                    for (int x = bounds.left; x < bounds.right; ++x) {
-                        if ((x < 0) || (x >= this->width())) {
-                            continue;
+    ModelImage & ModelImage::gather_drizzle(const DetectorImage & image) {
+        /** Drizzle a DetectorImage into this ModelImage by pulling instead of pushing.
+         *  An inverse index lists the candidate detector pixels of every model cell, so each thread can own
+         *  a disjoint block of model rows and write only there: no atomics, no buffers, no reduction.
+         *  Each cell receives its contributions in the row-major order of the detector,
+         *  so the result does not depend on the number of threads.
+         */
+        const InverseIndex index(this->size(), image, this->threads_);
+
+        parallel_for(0, this->height(), this->threads_, [&](int, int y_begin, int y_end) {
+            // Neighbouring cells share most of their detector pixels, so keep their world corners
+            // in a small direct-mapped cache to compute each of them (almost) only once
+            constexpr int CacheSize = 4096;
+            std::vector<int> cached(CacheSize, -1);
+            std::vector<Pixel> corners(CacheSize);
+
+            // The candidates of every cell are gathered into a structure-of-arrays batch for the vector kernel
+            PixelBatch batch;
+            std::vector<real> overlaps;
+
+            for (int y = y_begin; y < y_end; ++y) {
+                for (int x = 0; x < this->width(); ++x) {
+                    const auto candidates = index[x, y];
+                    batch.clear();
+                    for (int pixel: candidates) {
+                        const int slot = pixel & (CacheSize - 1);
+                        if (cached[slot] != pixel) {
+                            cached[slot] = pixel;
+                            corners[slot] = image.world_pixel(index.column(pixel), index.row(pixel));
                         }
-                        auto && model_pixel = this->pixel(x, y);
-
-                        // Compute the overlaps of model and detector pixels
-                        real overlap = model_pixel & image_pixel;
-                        if (overlap > DetectorImage::NegligibleOverlap) {
-                            // If not zero or negligibly small, add to the value at [x, y] the value
-                            // from source's [col, row], scaled by overlap and pixel area
-                            this->variance_(y, x) += overlap / image.pixel_area(col, row);
-                            (*this)[x, y] += image[col, row] * this->variance_(y, x);
-                            if ((3 * row + 2 * col) % 128 == 15) {
-                                fmt::print("{} {} - value {} to {} confidence {}\n",
-                                           col, row, (*this)[x, y], image[col, row], this->variance_(y, x));
-                            }
+                        batch.push_back(corners[slot]);
+                    }
+                    overlaps.resize(candidates.size());
+                    overlap_batch(batch, x, y, overlaps.data());
+
+                    real sum = 0;
+                    for (std::size_t i = 0; i < candidates.size(); ++i) {
+                        const int col = index.column(candidates[i]);
+                        const int row = index.row(candidates[i]);
+                        if (overlaps[i] > DetectorImage::NegligibleOverlap) {
+                            sum += image[col, row] * overlaps[i] / image.pixel_area(col, row);
                         }
                     }
+                    (*this)[x, y] += sum;
                 }
             }
-        }
+        });
+
+        return *this;
+    }
+
+    ModelImage & ModelImage::weighted_drizzle(const DetectorImage & image) {
+        /** Drizzle a DetectorImage into this ModelImage **/
+        for_each_overlap(this->size(), image, 0, image.height(), [&](int col, int row, int x, int y, real overlap) {
+            // Add to the value at [x, y] the value from source's [col, row], scaled by overlap and pixel area
+            this->variance_(y, x) += overlap / image.pixel_area(col, row);
+            (*this)[x, y] += image[col, row] * this->variance_(y, x);
+        });
 
         return *this;
     }
@@ -242,7 +363,7 @@ namespace Astar {
     }
 
     real ModelImage::total_flux() const {
-        real out = 0.0;
+        CompensatedSum out;
         for (int row = 0; row < this->height(); ++row) {
             for (int col = 0; col < this->width(); ++col) {
                 char c = character((*this)[col, row]);
@@ -251,18 +372,18 @@ namespace Astar {
             }
             fmt::print("\n");
         }
-        return out;
+        return out.value();
     }
 
     real ModelImage::dot_product(const ModelImage & other, int border) const {
         if (this->size() == other.size()) {
-            real diff = 0;
+            CompensatedSum diff;
             for (int row = border; row < this->height() - border; ++row) {
                 for (int col = border; col < this->width() - border; ++col) {
-                    diff += (*this)[col, row] * other[col, row];
+                    diff += static_cast<real>((*this)[col, row]) * other[col, row];
                 }
             }
-            return diff;
+            return diff.value();
         } else {
             throw std::invalid_argument(fmt::format("ModelImage sizes do not match_ {} != {}", this->size(), other.size()));
         }
@@ -270,19 +391,19 @@ namespace Astar {
 
     real ModelImage::squared_difference(const ModelImage & other, int border) const {
         if (this->size() == other.size()) {
-            real diff = 0;
+            CompensatedSum diff;
             for (int row = border; row < this->height() - border; ++row) {
                 for (int col = border; col < this->width() - border; ++col) {
-                    diff += std::pow((*this)[col, row] - other[col, row], 2);
+                    diff += std::pow(static_cast<real>((*this)[col, row]) - other[col, row], 2);
                 }
             }
-            return std::sqrt(diff / static_cast<real>(this->width() * this->height()));
+            return std::sqrt(diff.value() / static_cast<real>(this->width() * this->height()));
         } else {
             throw std::invalid_argument("ModelImage sizes do not match");
         }
     }
 
-    ModelImage & ModelImage::apply(const ModelImage & other, const std::function<real(real &, real)> & op) {
+    ModelImage & ModelImage::apply(const ModelImage & other, const std::function<real(storage &, real)> & op) {
         if (this->size() == other.size()) {
             for (int row = 0; row < this->height(); ++row) {
                 for (int col = 0; col < this->width(); ++col) {
@@ -301,12 +422,12 @@ namespace Astar {
      *  @return reference to this ModelImage
      */
     ModelImage & ModelImage::operator+=(const ModelImage & other) {
-        this->apply(other, [&](real & x, real y) { return x += y; });
+        this->apply(other, [&](storage & x, real y) { return x += y; });
         return (*this);
     }
 
     ModelImage & ModelImage::operator-=(const ModelImage & other) {
-        this->apply(other, [&](real & x, real y) { return x -= y; });
+        this->apply(other, [&](storage & x, real y) { return x -= y; });
         return (*this);
     }
 
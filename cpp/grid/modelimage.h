@@ -6,6 +6,7 @@
 #include "grid/placedgrid.h"
 #include "grid/pixel/pixel.h"
 #include "grid/detectorimage.h"
+#include "grid/exposureloader.h"
 
 
 namespace Astar {
@@ -18,9 +19,21 @@ namespace Astar {
      */
     class ModelImage: public Image<ModelImage> {
     private:
-        Matrix variance_;
+        RealMatrix variance_;
+        // Number of worker threads used when drizzling, values below 1 mean "all available cores"
+        int threads_ = 1;
+        // If set, parallel drizzling adds contributions in exactly the same order as the serial one
+        bool deterministic_ = false;
 
-        ModelImage & apply(const ModelImage & other, const std::function<real(real &, real)> & op);
+        ModelImage & apply(const ModelImage & other, const std::function<real(storage &, real)> & op);
+        /** Divide the weighted sums by the accumulated weights, marking cells with no coverage by -1 **/
+        ModelImage & normalise_weights();
+
+        /** Call callback(col, row, x, y, overlap) for every non-negligible overlap of the detector pixels
+         *  from rows [row_begin, row_end) of <image> with the pixels of a model of <size>, in row-major order **/
+        template<class Callback>
+        static void for_each_overlap(pair<int> size, const DetectorImage & image, int row_begin, int row_end,
+                                     Callback && callback);
     public:
         ModelImage(int width, int height);
         explicit ModelImage(pair<int> size);
@@ -29,16 +42,28 @@ namespace Astar {
 
         [[nodiscard]] Pixel pixel(int x, int y) const;
 
+        [[nodiscard]] int threads() const { return this->threads_; }
+        [[nodiscard]] bool deterministic() const { return this->deterministic_; }
+        ModelImage & set_threads(int threads);
+        ModelImage & set_deterministic(bool deterministic);
+
         ModelImage & naive_drizzle(const DetectorImage & image);
         ModelImage & naive_drizzle(const std::vector<DetectorImage> & images);
+        /** Drizzle exposures as the loader delivers them, loading the next one while this one is being drizzled **/
+        ModelImage & naive_drizzle(ExposureLoader & loader);
         ModelImage & weighted_drizzle(const DetectorImage & image);
         ModelImage & weighted_drizzle(const std::vector<DetectorImage> & images);
+        ModelImage & weighted_drizzle(ExposureLoader & loader);
+        ModelImage & gather_drizzle(const DetectorImage & image);
+        ModelImage & gather_drizzle(const std::vector<DetectorImage> & images);
 
         //ModelImage & operator+=(const DetectorImage & image);
         ModelImage & operator+=(const ModelImage & other);
         ModelImage & operator-=(const ModelImage & other);
 
         [[nodiscard]] SparseMatrix overlap_matrix(const DetectorImage & image) const;
+        /** Overlap matrix for a model of the given size, without needing one in memory **/
+        [[nodiscard]] static SparseMatrix overlap_matrix(pair<int> model_size, const DetectorImage & image, int threads = 1);
 
         // Find the mean square difference between the pictures, expressed as a number between 0 and 1
         [[nodiscard]] real dot_product(const ModelImage & other, int border = 0) const;
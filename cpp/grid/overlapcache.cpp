@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <unistd.h>
+
+#include "overlapcache.h"
+#include "utils/mappedfile.h"
+
+namespace Astar {
+    namespace {
+        // Change the format number whenever the layout of the file changes
+        constexpr char Magic[8] = {'A', 'N', 'A', 'C', 'S', 'R', '0', '2'};
+
+        /** Everything an overlap matrix depends on, stored in full to be compared on load **/
+        struct Geometry {
+            real centre_x;
+            real centre_y;
+            real physical_width;
+            real physical_height;
+            real rotation;
+            real pixfrac_x;
+            real pixfrac_y;
+            std::int32_t width;
+            std::int32_t height;
+            std::int32_t model_width;
+            std::int32_t model_height;
+
+            Geometry(pair<int> model_size, const DetectorImage & image):
+                centre_x(image.centre().x),
+                centre_y(image.centre().y),
+                physical_width(image.physical_size().first),
+                physical_height(image.physical_size().second),
+                rotation(image.rotation()),
+                pixfrac_x(image.pixfrac().first),
+                pixfrac_y(image.pixfrac().second),
+                width(image.width()),
+                height(image.height()),
+                model_width(model_size.first),
+                model_height(model_size.second)
+            {}
+
+            bool operator==(const Geometry & other) const = default;
+        };
+        static_assert(sizeof(Geometry) == 72, "Geometry must have no padding");
+
+        struct FileHeader {
+            char magic[8];
+            std::uint32_t scalar_size;
+            std::uint32_t kernel_version;
+            std::int64_t rows;
+            std::int64_t cols;
+            std::int64_t nonzeros;
+            std::uint64_t key;
+            Geometry geometry;
+            char padding[8];
+        };
+        static_assert(sizeof(FileHeader) == 128, "Cache file header must be exactly 128 bytes");
+
+        /** Byte offsets of the three arrays that follow the header **/
+        struct Layout {
+            std::size_t outer;
+            std::size_t inner;
+            std::size_t values;
+            std::size_t end;
+
+            Layout(std::int64_t rows, std::int64_t nonzeros):
+                outer(sizeof(FileHeader)),
+                inner(outer + (rows + 1) * sizeof(int)),
+                values((inner + nonzeros * sizeof(int) + 7) / 8 * 8),
+                end(values + nonzeros * sizeof(storage))
+            {}
+        };
+
+        class Fnv1a {
+        private:
+            std::uint64_t hash_ = 0xcbf29ce484222325ULL;
+        public:
+            template<class T>
+            Fnv1a & add(const T & value) {
+                const auto * bytes = reinterpret_cast<const unsigned char *>(&value);
+                for (std::size_t i = 0; i < sizeof(T); ++i) {
+                    this->hash_ = (this->hash_ ^ bytes[i]) * 0x100000001b3ULL;
+                }
+                return *this;
+            }
+
+            [[nodiscard]] std::uint64_t value() const { return this->hash_; }
+        };
+    }
+
+    OverlapCache::OverlapCache(std::filesystem::path directory, std::uintmax_t size_limit):
+        directory_(std::move(directory)),
+        size_limit_(size_limit)
+    {
+        std::filesystem::create_directories(this->directory_);
+    }
+
+    std::uint64_t OverlapCache::key(pair<int> model_size, const DetectorImage & image) {
+        Fnv1a hash;
+        hash.add(image.centre().x).add(image.centre().y)
+            .add(image.physical_size().first).add(image.physical_size().second)
+            .add(image.rotation())
+            .add(image.pixfrac().first).add(image.pixfrac().second)
+            .add(image.width()).add(image.height())
+            .add(model_size.first).add(model_size.second)
+            .add(static_cast<std::uint32_t>(sizeof(storage)));
+        return hash.value();
+    }
+
+    std::filesystem::path OverlapCache::path(std::uint64_t key) const {
+        return this->directory_ / fmt::format("{:016x}.csr", key);
+    }
+
+    SparseMatrix OverlapCache::overlap_matrix(const ModelImage & model, const DetectorImage & image) {
+        const std::uint64_t key = OverlapCache::key(model.size(), image);
+        if (auto cached = this->load(key, model.size(), image)) {
+            ++this->statistics_.hits;
+            return std::move(*cached);
+        }
+
+        ++this->statistics_.misses;
+        SparseMatrix matrix = model.overlap_matrix(image);
+        this->store(key, model.size(), image, matrix);
+        this->evict();
+        return matrix;
+    }
+
+    std::optional<SparseMatrix> OverlapCache::load(std::uint64_t key, pair<int> model_size,
+                                                   const DetectorImage & image) {
+        const auto filename = this->path(key);
+        if (!std::filesystem::exists(filename)) {
+            return std::nullopt;
+        }
+
+        std::optional<SparseMatrix> matrix;
+        try {
+            const MappedFile file(filename.string());
+            if (file.size() < sizeof(FileHeader)) {
+                throw std::runtime_error("file too short");
+            }
+            const FileHeader & header = *file.view<FileHeader>(0);
+            if ((std::memcmp(header.magic, Magic, sizeof Magic) != 0) || (header.scalar_size != sizeof(storage)) ||
+                (header.kernel_version != KernelVersion) || (header.key != key) ||
+                !(header.geometry == Geometry(model_size, image))) {
+                throw std::runtime_error("computed for another geometry, kernel or storage type");
+            }
+            if ((header.rows != image.count()) ||
+                (header.cols != static_cast<std::int64_t>(model_size.first) * model_size.second) ||
+                (header.nonzeros < 0) || (Layout(header.rows, header.nonzeros).end > file.size())) {
+                throw std::runtime_error("inconsistent header");
+            }
+
+            // Views are bounds-checked, so a file truncated after the header throws here as well
+            const Layout layout(header.rows, header.nonzeros);
+            const int * outer = file.view<int>(layout.outer, header.rows + 1);
+            const int * inner = file.view<int>(layout.inner, header.nonzeros);
+            const storage * values = file.view<storage>(layout.values, header.nonzeros);
+
+            // Indices come from outside, so check them before Eigen relies on them: rows must start at zero,
+            // never decrease and end at the number of nonzeros, columns must be increasing within a row and in range
+            if ((header.nonzeros > std::numeric_limits<int>::max()) || (outer[0] != 0) ||
+                (outer[header.rows] != header.nonzeros)) {
+                throw std::runtime_error("outer indices do not span the nonzeros");
+            }
+            for (std::int64_t row = 0; row < header.rows; ++row) {
+                if (outer[row + 1] < outer[row]) {
+                    throw std::runtime_error(fmt::format("outer indices decrease at row {}", row));
+                }
+                for (int k = outer[row]; k < outer[row + 1]; ++k) {
+                    if ((inner[k] < 0) || (inner[k] >= header.cols) ||
+                        ((k > outer[row]) && (inner[k] <= inner[k - 1]))) {
+                        throw std::runtime_error(fmt::format("invalid column index {} in row {}", inner[k], row));
+                    }
+                }
+            }
+
+            matrix.emplace(header.rows, header.cols);
+            matrix->resizeNonZeros(header.nonzeros);
+            std::copy_n(outer, header.rows + 1, matrix->outerIndexPtr());
+            std::copy_n(inner, header.nonzeros, matrix->innerIndexPtr());
+            std::copy_n(values, header.nonzeros, matrix->valuePtr());
+            this->statistics_.bytes_read += file.size();
+        } catch (const std::exception & exception) {
+            fmt::print("Ignoring overlap cache file {}: {}\n", filename.string(), exception.what());
+            return std::nullopt;
+        }
+
+        // Mark as recently used, so that it is evicted last. Best effort only, the directory may be read-only.
+        std::error_code error;
+        std::filesystem::last_write_time(filename, std::filesystem::file_time_type::clock::now(), error);
+        return matrix;
+    }
+
+    void OverlapCache::store(std::uint64_t key, pair<int> model_size, const DetectorImage & image,
+                             const SparseMatrix & matrix) {
+        if (!matrix.isCompressed()) {
+            throw std::invalid_argument("Only compressed matrices can be cached");
+        }
+
+        FileHeader header {
+            .magic = {},
+            .scalar_size = sizeof(storage),
+            .kernel_version = KernelVersion,
+            .rows = matrix.rows(),
+            .cols = matrix.cols(),
+            .nonzeros = matrix.nonZeros(),
+            .key = key,
+            .geometry = Geometry(model_size, image),
+            .padding = {},
+        };
+        std::memcpy(header.magic, Magic, sizeof Magic);
+        const Layout layout(header.rows, header.nonzeros);
+
+        // Write to a temporary file first, so that a concurrent reader never sees a partial file
+        const auto filename = this->path(key);
+        auto temporary = filename;
+        temporary += fmt::format(".{}.tmp", ::getpid());
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            if (!out) {
+                throw std::runtime_error(fmt::format("Could not write overlap cache file {}", temporary.string()));
+            }
+            const char zeros[8] = {};
+            out.write(reinterpret_cast<const char *>(&header), sizeof header);
+            out.write(reinterpret_cast<const char *>(matrix.outerIndexPtr()), (header.rows + 1) * sizeof(int));
+            out.write(reinterpret_cast<const char *>(matrix.innerIndexPtr()), header.nonzeros * sizeof(int));
+            out.write(zeros, static_cast<std::streamsize>(layout.values - layout.inner - header.nonzeros * sizeof(int)));
+            out.write(reinterpret_cast<const char *>(matrix.valuePtr()), header.nonzeros * sizeof(storage));
+            if (!out) {
+                throw std::runtime_error(fmt::format("Could not write overlap cache file {}", temporary.string()));
+            }
+        }
+        std::filesystem::rename(temporary, filename);
+        this->statistics_.bytes_written += layout.end;
+    }
+
+    void OverlapCache::evict() {
+        struct Entry {
+            std::filesystem::path path;
+            std::uintmax_t size;
+            std::filesystem::file_time_type used;
+        };
+
+        std::vector<Entry> entries;
+        std::uintmax_t total = 0;
+        for (auto && entry: std::filesystem::directory_iterator(this->directory_)) {
+            if (entry.is_regular_file() && (entry.path().extension() == ".csr")) {
+                entries.push_back({entry.path(), entry.file_size(), entry.last_write_time()});
+                total += entries.back().size;
+            }
+        }
+        if (total <= this->size_limit_) {
+            return;
+        }
+
+        // Least recently used first
+        std::sort(entries.begin(), entries.end(), [](const Entry & a, const Entry & b) { return a.used < b.used; });
+        for (auto && entry: entries) {
+            if (total <= this->size_limit_) {
+                break;
+            }
+            std::filesystem::remove(entry.path);
+            total -= entry.size;
+            ++this->statistics_.evictions;
+        }
+    }
+
+    void OverlapCache::print_statistics() const {
+        fmt::print("Overlap cache {}: {} hits, {} misses, {} evictions, {} bytes read, {} bytes written\n",
+                   this->directory_.string(), this->statistics_.hits, this->statistics_.misses,
+                   this->statistics_.evictions, this->statistics_.bytes_read, this->statistics_.bytes_written);
+    }
+}
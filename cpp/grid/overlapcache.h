@@ -0,0 +1,67 @@
+#ifndef ANASTASIS_CPP_OVERLAPCACHE_H
+#define ANASTASIS_CPP_OVERLAPCACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+#include "utils/eigen.h"
+#include "grid/detectorimage.h"
+#include "grid/modelimage.h"
+
+namespace Astar {
+    /** Persistent cache of overlap matrices in a directory, keyed by the geometry of the exposure
+     *  (centre, physical size, rotation, pixfrac and grid size) and the size of the model.
+     *  Every matrix is stored in its own file in compressed row form:
+     *
+     *      header (128 bytes): magic "ANACSR02", scalar size, kernel version, rows, cols, nonzeros,
+     *                          geometry key and the full geometry the matrix was computed for
+     *      outer indices (rows + 1 × int32), inner indices (nonzeros × int32), padding to 8 bytes,
+     *      values (nonzeros × storage)
+     *
+     *  The key only names the file: a file is used only if its geometry and kernel version match exactly
+     *  and its indices form a valid compressed matrix, anything else (a hash collision, an older kernel,
+     *  a truncated, corrupt or foreign file) counts as a miss and is overwritten.
+     *  Files are memory-mapped on load and their arrays copied straight into the matrix.
+     *  If the files take more than the size limit, the least recently used ones are removed.
+     */
+    class OverlapCache {
+    public:
+        struct Statistics {
+            int hits = 0;
+            int misses = 0;
+            int evictions = 0;
+            std::uintmax_t bytes_read = 0;
+            std::uintmax_t bytes_written = 0;
+        };
+    private:
+        std::filesystem::path directory_;
+        std::uintmax_t size_limit_;
+        Statistics statistics_;
+
+        [[nodiscard]] std::filesystem::path path(std::uint64_t key) const;
+        [[nodiscard]] std::optional<SparseMatrix> load(std::uint64_t key, pair<int> model_size,
+                                                       const DetectorImage & image);
+        void store(std::uint64_t key, pair<int> model_size, const DetectorImage & image, const SparseMatrix & matrix);
+        void evict();
+    public:
+        constexpr static std::uintmax_t DefaultSizeLimit = std::uintmax_t(1) << 30;
+        /** Increase whenever the overlap kernel changes its results, so that older files are recomputed **/
+        constexpr static std::uint32_t KernelVersion = 1;
+
+        explicit OverlapCache(std::filesystem::path directory, std::uintmax_t size_limit = DefaultSizeLimit);
+
+        /** FNV-1a hash of everything the overlap matrix depends on **/
+        [[nodiscard]] static std::uint64_t key(pair<int> model_size, const DetectorImage & image);
+
+        /** Overlap matrix of <image> with <model>, loaded from the cache or computed and stored **/
+        [[nodiscard]] SparseMatrix overlap_matrix(const ModelImage & model, const DetectorImage & image);
+
+        [[nodiscard]] const std::filesystem::path & directory() const { return this->directory_; }
+        [[nodiscard]] std::uintmax_t size_limit() const { return this->size_limit_; }
+        [[nodiscard]] const Statistics & statistics() const { return this->statistics_; }
+        void print_statistics() const;
+    };
+}
+
+#endif //ANASTASIS_CPP_OVERLAPCACHE_H
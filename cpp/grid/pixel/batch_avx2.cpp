@@ -0,0 +1,31 @@
+/** AVX2 instantiation of the batched overlap kernel, compiled with -mavx2 and called only if the CPU supports it **/
+#include <immintrin.h>
+
+#include "batchkernel.h"
+
+namespace Astar::Kernel {
+    namespace {
+        struct Avx2 {
+            using V = __m256d;
+            constexpr static std::size_t Width = 4;
+
+            static V set(double value) { return _mm256_set1_pd(value); }
+            static V load(const double * source) { return _mm256_loadu_pd(source); }
+            static void store(double * target, V value) { _mm256_storeu_pd(target, value); }
+            static V min(V a, V b) { return _mm256_min_pd(a, b); }
+            static V max(V a, V b) { return _mm256_max_pd(a, b); }
+            static V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+            static V select_nonzero(V condition, V a, V b) {
+                return _mm256_blendv_pd(b, a, _mm256_cmp_pd(condition, _mm256_setzero_pd(), _CMP_NEQ_UQ));
+            }
+        };
+    }
+
+    void overlap_batch_avx2(const double * const * corners, std::size_t count, double left, double bottom, double * out) {
+        batch<Avx2>(corners, count, left, bottom, out);
+    }
+
+    void overlap_row_avx2(const double * corners, double left, double bottom, std::size_t count, double * out) {
+        row<Avx2>(corners, left, bottom, count, out);
+    }
+}
@@ -0,0 +1,31 @@
+/** AVX-512 instantiation of the batched overlap kernel, compiled with -mavx512f and called only if the CPU supports it **/
+#include <immintrin.h>
+
+#include "batchkernel.h"
+
+namespace Astar::Kernel {
+    namespace {
+        struct Avx512 {
+            using V = __m512d;
+            constexpr static std::size_t Width = 8;
+
+            static V set(double value) { return _mm512_set1_pd(value); }
+            static V load(const double * source) { return _mm512_loadu_pd(source); }
+            static void store(double * target, V value) { _mm512_storeu_pd(target, value); }
+            static V min(V a, V b) { return _mm512_min_pd(a, b); }
+            static V max(V a, V b) { return _mm512_max_pd(a, b); }
+            static V abs(V a) { return _mm512_abs_pd(a); }
+            static V select_nonzero(V condition, V a, V b) {
+                return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(condition, _mm512_setzero_pd(), _CMP_NEQ_UQ), b, a);
+            }
+        };
+    }
+
+    void overlap_batch_avx512(const double * const * corners, std::size_t count, double left, double bottom, double * out) {
+        batch<Avx512>(corners, count, left, bottom, out);
+    }
+
+    void overlap_row_avx512(const double * corners, double left, double bottom, std::size_t count, double * out) {
+        row<Avx512>(corners, left, bottom, count, out);
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef ANASTASIS_CPP_BATCHKERNEL_H
+#define ANASTASIS_CPP_BATCHKERNEL_H
+
+#include <cstddef>
+
+/** Branch-free overlap kernel shared by the instruction-set specific translation units.
+ *  Only included by those, each of which is compiled with its own target flags: everything here must stay
+ *  in an anonymous namespace so that no instantiation compiled for one instruction set leaks into another.
+ *  For the same reason no other project headers are pulled in and the kernel is spelled out for double.
+ *
+ *  The area of a convex polygon P within the cell [l, l + 1] × [b, b + 1] follows from Green's theorem as
+ *      ∮ g(x) dy   with   g(x) = clamp(x, l, l + 1) - l,
+ *  integrated along the boundary of P clipped to the horizontal band b <= y <= b + 1.
+ *  For a straight edge this is just its height within the band times the mean of g along it,
+ *  so every edge contributes a handful of min, max, multiplications and one selection.
+ */
+namespace Astar::Kernel {
+    using BatchFunction = void (*)(const double * const * corners, std::size_t count, double left, double bottom, double * out);
+    using RowFunction = void (*)(const double * corners, double left, double bottom, std::size_t count, double * out);
+
+    void overlap_batch_avx2(const double * const * corners, std::size_t count, double left, double bottom, double * out);
+    void overlap_row_avx2(const double * corners, double left, double bottom, std::size_t count, double * out);
+    void overlap_batch_avx512(const double * const * corners, std::size_t count, double left, double bottom, double * out);
+    void overlap_row_avx512(const double * corners, double left, double bottom, std::size_t count, double * out);
+
+    namespace {
+        template<class Ops, class V = typename Ops::V>
+        inline V clamp(V value, V low, V high) {
+            return Ops::min(Ops::max(value, low), high);
+        }
+
+        /** Integral of g(x) dy along the part of the edge p -> q that lies within the band **/
+        template<class Ops, class V = typename Ops::V>
+        inline V edge_integral(V px, V py, V qx, V qy, V left, V bottom) {
+            const V zero = Ops::set(0);
+            const V one = Ops::set(1);
+            const V right = left + one;
+            const V top = bottom + one;
+
+            const V ya = clamp<Ops>(py, bottom, top);
+            const V yb = clamp<Ops>(qy, bottom, top);
+            const V height = qy - py;
+            const V slope = Ops::select_nonzero(height, (qx - px) / height, zero);
+            const V xa = px + (ya - py) * slope;
+            const V xb = px + (yb - py) * slope;
+
+            // Mean of g over [low, high], split into the part within the cell and the part to its right
+            const V low = Ops::min(xa, xb);
+            const V high = Ops::max(xa, xb);
+            const V span = high - low;
+            const V m1 = clamp<Ops>(low, left, right);
+            const V m2 = clamp<Ops>(high, left, right);
+            const V inverse = one / Ops::select_nonzero(span, span, one);
+            const V mean = Ops::select_nonzero(
+                span,
+                Ops::set(0.5) * (m2 - m1) * inverse * (m1 + m2 - left - left)
+                    + Ops::max(high - Ops::max(low, right), zero) * inverse,
+                m1 - left
+            );
+            return mean * (yb - ya);
+        }
+
+        /** Overlap of the quadrilateral with corners (x[i], y[i]) with the cell at (left, bottom) **/
+        template<class Ops, class V = typename Ops::V>
+        inline V quad_overlap(const V (& x)[4], const V (& y)[4], V left, V bottom) {
+            return Ops::abs(
+                edge_integral<Ops>(x[0], y[0], x[1], y[1], left, bottom) +
+                edge_integral<Ops>(x[1], y[1], x[2], y[2], left, bottom) +
+                edge_integral<Ops>(x[2], y[2], x[3], y[3], left, bottom) +
+                edge_integral<Ops>(x[3], y[3], x[0], y[0], left, bottom)
+            );
+        }
+
+        /** N pixels against one cell, the last incomplete group goes through a padded copy **/
+        template<class Ops, class V = typename Ops::V>
+        inline void batch(const double * const * corners, std::size_t count, double left, double bottom, double * out) {
+            constexpr std::size_t W = Ops::Width;
+            const V l = Ops::set(left);
+            const V b = Ops::set(bottom);
+            V x[4], y[4];
+
+            std::size_t i = 0;
+            for (; i + W <= count; i += W) {
+                for (int k = 0; k < 4; ++k) {
+                    x[k] = Ops::load(corners[2 * k] + i);
+                    y[k] = Ops::load(corners[2 * k + 1] + i);
+                }
+                Ops::store(out + i, quad_overlap<Ops>(x, y, l, b));
+            }
+            if (i < count) {
+                double padded[8][W] = {};
+                double result[W];
+                for (int k = 0; k < 8; ++k) {
+                    for (std::size_t j = i; j < count; ++j) {
+                        padded[k][j - i] = corners[k][j];
+                    }
+                }
+                for (int k = 0; k < 4; ++k) {
+                    x[k] = Ops::load(padded[2 * k]);
+                    y[k] = Ops::load(padded[2 * k + 1]);
+                }
+                Ops::store(result, quad_overlap<Ops>(x, y, l, b));
+                for (std::size_t j = i; j < count; ++j) {
+                    out[j] = result[j - i];
+                }
+            }
+        }
+
+        /** One pixel against a row of cells, lanes differ only in the left edge of their cell **/
+        template<class Ops, class V = typename Ops::V>
+        inline void row(const double * corners, double left, double bottom, std::size_t count, double * out) {
+            constexpr std::size_t W = Ops::Width;
+            const V b = Ops::set(bottom);
+            V x[4], y[4];
+            for (int k = 0; k < 4; ++k) {
+                x[k] = Ops::set(corners[2 * k]);
+                y[k] = Ops::set(corners[2 * k + 1]);
+            }
+
+            double lefts[W];
+            double result[W];
+            for (std::size_t i = 0; i < count; i += W) {
+                for (std::size_t j = 0; j < W; ++j) {
+                    lefts[j] = left + static_cast<double>(i + j);
+                }
+                Ops::store(result, quad_overlap<Ops>(x, y, Ops::load(lefts), b));
+                for (std::size_t j = 0; (j < W) && (i + j < count); ++j) {
+                    out[i + j] = result[j];
+                }
+            }
+        }
+    }
+}
+
+#endif //ANASTASIS_CPP_BATCHKERNEL_H
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <limits>
+
+#include "coverage.h"
+
+namespace Astar {
+    void CoverageRasterizer::rasterize(const Pixel & pixel) {
+        auto xs = {pixel.a().x, pixel.b().x, pixel.c().x, pixel.d().x};
+        auto ys = {pixel.a().y, pixel.b().y, pixel.c().y, pixel.d().y};
+        this->left_ = static_cast<int>(std::floor(std::min(xs)));
+        this->bottom_ = static_cast<int>(std::floor(std::min(ys)));
+        this->width_ = static_cast<int>(std::ceil(std::max(xs))) - this->left_ + 2;
+        this->height_ = static_cast<int>(std::ceil(std::max(ys))) - this->bottom_;
+
+        const auto cells = static_cast<std::size_t>(this->width_) * this->height_;
+        if (this->accumulator_.size() < cells) {
+            this->accumulator_.resize(cells, 0);
+        }
+        this->first_.assign(this->height_, std::numeric_limits<int>::max());
+        this->last_.assign(this->height_, -1);
+
+        // Walk the boundary anti-clockwise: a -> b -> c -> d -> a, relative to the window origin
+        const Point origin(this->left_, this->bottom_);
+        const Point a = pixel.a() - origin;
+        const Point b = pixel.b() - origin;
+        const Point c = pixel.c() - origin;
+        const Point d = pixel.d() - origin;
+        this->edge(a, b);
+        this->edge(b, c);
+        this->edge(c, d);
+        this->edge(d, a);
+    }
+
+    void CoverageRasterizer::touch(int y, int first, int last) {
+        this->first_[y] = std::min(this->first_[y], first);
+        this->last_[y] = std::max(this->last_[y], last);
+    }
+
+    void CoverageRasterizer::edge(Point p0, Point p1) {
+        /** Deposit the signed area between the edge and the right side of the window.
+         *  After the running sum along a scanline, every cell holds the area covered within it. **/
+        if (p0.y == p1.y) {
+            // Horizontal edges do not contribute anything
+            return;
+        }
+        real direction = 1;
+        if (p0.y > p1.y) {
+            std::swap(p0, p1);
+            direction = -1;
+        }
+
+        const real dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+        const real low = std::min(p0.x, p1.x);
+        const real high = std::max(p0.x, p1.x);
+        const int y_begin = std::max(static_cast<int>(std::floor(p0.y)), 0);
+        const int y_end = std::min(static_cast<int>(std::ceil(p1.y)), this->height_);
+
+        for (int y = y_begin; y < y_end; ++y) {
+            // Part of the edge within this scanline, x computed directly (and clamped) to avoid drifting
+            const real ya = std::max(static_cast<real>(y), p0.y);
+            const real yb = std::min(static_cast<real>(y + 1), p1.y);
+            if (yb <= ya) {
+                continue;
+            }
+            const real xa = std::clamp(p0.x + (ya - p0.y) * dxdy, low, high);
+            const real xb = std::clamp(p0.x + (yb - p0.y) * dxdy, low, high);
+            const real d = (yb - ya) * direction;
+            const real x0 = std::min(xa, xb);
+            const real x1 = std::max(xa, xb);
+            const real x0_floor = std::floor(x0);
+            const real x1_ceil = std::ceil(x1);
+            const int x0i = static_cast<int>(x0_floor);
+            const int x1i = static_cast<int>(x1_ceil);
+            real * row = this->accumulator_.data() + static_cast<std::size_t>(y) * this->width_;
+
+            if (x1i <= x0i + 1) {
+                // The piece stays within a single cell: split by the position of its midpoint
+                const real middle = 0.5 * (xa + xb) - x0_floor;
+                row[x0i] += d - d * middle;
+                row[x0i + 1] += d * middle;
+                this->touch(y, x0i, x0i + 1);
+            } else {
+                // The piece crosses several cells: the covered area grows linearly in the middle
+                // and quadratically in the first and the last cell
+                const real s = 1.0 / (x1 - x0);
+                const real x0_fraction = x0 - x0_floor;
+                const real x1_fraction = x1 - x1_ceil + 1.0;
+                const real a0 = 0.5 * s * (1.0 - x0_fraction) * (1.0 - x0_fraction);
+                const real am = 0.5 * s * x1_fraction * x1_fraction;
+                row[x0i] += d * a0;
+                if (x1i == x0i + 2) {
+                    row[x0i + 1] += d * (1.0 - a0 - am);
+                } else {
+                    const real a1 = s * (1.5 - x0_fraction);
+                    row[x0i + 1] += d * (a1 - a0);
+                    for (int x = x0i + 2; x < x1i - 1; ++x) {
+                        row[x] += d * s;
+                    }
+                    const real a2 = a1 + static_cast<real>(x1i - x0i - 3) * s;
+                    row[x1i - 1] += d * (1.0 - a2 - am);
+                }
+                row[x1i] += d * am;
+                this->touch(y, x0i, x1i);
+            }
+        }
+    }
+}
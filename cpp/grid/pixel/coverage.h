@@ -0,0 +1,59 @@
+#ifndef ANASTASIS_CPP_COVERAGE_H
+#define ANASTASIS_CPP_COVERAGE_H
+
+#include <vector>
+
+#include "grid/box.h"
+#include "grid/pixel/pixel.h"
+
+namespace Astar {
+    /** Exact area coverage of a pixel over the unit cells of the plane, computed the way font rasterizers do it:
+     *  every edge is walked once and deposits its signed area into an accumulation buffer,
+     *  then a running sum along every scanline turns the deposits into covered areas (Green's theorem).
+     *  The cost is proportional to the perimeter plus the number of covered cells, not to the bounding box.
+     *
+     *  The buffer is reused between calls and left clean after each, so one instance per thread
+     *  can rasterize any number of pixels without allocating.
+     */
+    class CoverageRasterizer {
+    private:
+        // Window of cells touched by the current pixel, with two spare columns on the right
+        int left_ = 0;
+        int bottom_ = 0;
+        int width_ = 0;
+        int height_ = 0;
+        std::vector<real> accumulator_;
+        // Range of touched columns for every scanline of the window
+        std::vector<int> first_;
+        std::vector<int> last_;
+
+        void edge(Point p0, Point p1);
+        void touch(int y, int first, int last);
+    public:
+        /** Deposit the edges of a pixel, must be followed by a call to for_each **/
+        void rasterize(const Pixel & pixel);
+
+        /** Call callback(x, y, area) for every cell inside <clip> covered by more than <threshold>,
+         *  in row-major order, and clear the buffer **/
+        template<class Callback>
+        void for_each(const Box & clip, real threshold, Callback && callback) {
+            for (int y = 0; y < this->height_; ++y) {
+                real * row = this->accumulator_.data() + static_cast<std::size_t>(y) * this->width_;
+                const int cell_y = this->bottom_ + y;
+                const bool inside = (clip.bottom <= cell_y) && (cell_y < clip.top);
+                real area = 0;
+                for (int x = this->first_[y]; x <= this->last_[y]; ++x) {
+                    area += row[x];
+                    row[x] = 0;
+                    const int cell_x = this->left_ + x;
+                    if (inside && (clip.left <= cell_x) && (cell_x < clip.right) && (std::abs(area) > threshold)) {
+                        callback(cell_x, cell_y, std::abs(area));
+                    }
+                }
+            }
+            this->height_ = 0;
+        }
+    };
+}
+
+#endif //ANASTASIS_CPP_COVERAGE_H
@@ -0,0 +1,131 @@
+#include "pixelbatch.h"
+#include "preparedpixel.h"
+#include "batchkernel.h"
+
+namespace Astar {
+    static_assert(std::is_same_v<real, double>, "Batched overlap kernels are written for double precision geometry");
+
+    void PixelBatch::clear() {
+        for (auto && coordinate: this->coordinates_) {
+            coordinate.clear();
+        }
+    }
+
+    void PixelBatch::reserve(std::size_t size) {
+        for (auto && coordinate: this->coordinates_) {
+            coordinate.reserve(size);
+        }
+    }
+
+    void PixelBatch::push_back(const Pixel & pixel) {
+        int index = 0;
+        for (auto && corner: {pixel.a(), pixel.b(), pixel.c(), pixel.d()}) {
+            this->coordinates_[index++].push_back(corner.x);
+            this->coordinates_[index++].push_back(corner.y);
+        }
+    }
+
+    namespace {
+        Pixel unpack(const real * const * corners, std::size_t i) {
+            return Pixel(
+                {corners[0][i], corners[1][i]}, {corners[2][i], corners[3][i]},
+                {corners[6][i], corners[7][i]}, {corners[4][i], corners[5][i]}
+            );
+        }
+
+        /** Fallback for CPUs without vector extensions: clip every pixel separately **/
+        void overlap_batch_scalar(const real * const * corners, std::size_t count, real left, real bottom, real * out) {
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = PreparedPixel(unpack(corners, i)).overlap_unit_cell(static_cast<int>(left), static_cast<int>(bottom));
+            }
+        }
+
+        void overlap_row_scalar(const real * corners, real left, real bottom, std::size_t count, real * out) {
+            const real * rows[8] = {corners, corners + 1, corners + 2, corners + 3,
+                                    corners + 4, corners + 5, corners + 6, corners + 7};
+            const PreparedPixel prepared(unpack(rows, 0));
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = prepared.overlap_unit_cell(static_cast<int>(left) + static_cast<int>(i), static_cast<int>(bottom));
+            }
+        }
+
+        struct Dispatch {
+            const char * name;
+            Kernel::BatchFunction batch;
+            Kernel::RowFunction row;
+        };
+
+        /** Instruction sets supported by the CPU, the widest first and the scalar fallback last, detected once **/
+        const std::vector<Dispatch> & supported() {
+            static const std::vector<Dispatch> kernels = [] {
+                std::vector<Dispatch> found;
+#ifdef ANASTASIS_X86_KERNELS
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx512f")) {
+                    found.push_back({"avx512", Kernel::overlap_batch_avx512, Kernel::overlap_row_avx512});
+                }
+                if (__builtin_cpu_supports("avx2")) {
+                    found.push_back({"avx2", Kernel::overlap_batch_avx2, Kernel::overlap_row_avx2});
+                }
+#endif
+                found.push_back({"scalar", overlap_batch_scalar, overlap_row_scalar});
+                return found;
+            }();
+            return kernels;
+        }
+
+        const Dispatch & dispatch() {
+            return supported().front();
+        }
+
+        const Dispatch & dispatch(const std::string & kernel) {
+            for (auto && candidate: supported()) {
+                if (candidate.name == kernel) {
+                    return candidate;
+                }
+            }
+            throw std::invalid_argument(fmt::format("Overlap kernel '{}' is not available on this CPU", kernel));
+        }
+
+        const real * const * unpacked(const PixelBatch & batch, const real * (& corners)[8]) {
+            for (int k = 0; k < 8; ++k) {
+                corners[k] = batch.coordinate(k);
+            }
+            return corners;
+        }
+    }
+
+    void overlap_batch(const PixelBatch & batch, int x, int y, real * out) {
+        const real * corners[8];
+        dispatch().batch(unpacked(batch, corners), batch.size(), static_cast<real>(x), static_cast<real>(y), out);
+    }
+
+    void overlap_batch(const PixelBatch & batch, int x, int y, real * out, const std::string & kernel) {
+        const real * corners[8];
+        dispatch(kernel).batch(unpacked(batch, corners), batch.size(), static_cast<real>(x), static_cast<real>(y), out);
+    }
+
+    void overlap_row(const Pixel & pixel, int x, int y, int count, real * out) {
+        const real corners[8] = {pixel.a().x, pixel.a().y, pixel.b().x, pixel.b().y,
+                                 pixel.c().x, pixel.c().y, pixel.d().x, pixel.d().y};
+        dispatch().row(corners, static_cast<real>(x), static_cast<real>(y), static_cast<std::size_t>(count), out);
+    }
+
+    void overlap_row(const Pixel & pixel, int x, int y, int count, real * out, const std::string & kernel) {
+        const real corners[8] = {pixel.a().x, pixel.a().y, pixel.b().x, pixel.b().y,
+                                 pixel.c().x, pixel.c().y, pixel.d().x, pixel.d().y};
+        dispatch(kernel).row(corners, static_cast<real>(x), static_cast<real>(y), static_cast<std::size_t>(count), out);
+    }
+
+    const char * overlap_kernel() {
+        return dispatch().name;
+    }
+
+    std::vector<std::string> overlap_kernels() {
+        std::vector<std::string> names;
+        for (auto && kernel: supported()) {
+            names.emplace_back(kernel.name);
+        }
+        return names;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef ANASTASIS_CPP_PIXELBATCH_H
+#define ANASTASIS_CPP_PIXELBATCH_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "grid/pixel/pixel.h"
+
+namespace Astar {
+    /** A batch of pixels in structure-of-arrays layout: every corner coordinate lives in its own contiguous array,
+     *  so that the overlaps of many pixels can be computed at once with vector instructions.
+     *  Corners are stored anti-clockwise (a, b, c, d) as x0, y0, x1, y1, ..., x3, y3.
+     */
+    class PixelBatch {
+    private:
+        std::array<std::vector<real>, 8> coordinates_;
+    public:
+        void clear();
+        void push_back(const Pixel & pixel);
+        void reserve(std::size_t size);
+
+        [[nodiscard]] std::size_t size() const { return this->coordinates_[0].size(); }
+        [[nodiscard]] const real * coordinate(int index) const { return this->coordinates_[index].data(); }
+    };
+
+    /** Areas of the overlaps of every pixel in the batch with the unit model cell (x, y), written to out[0 .. size) **/
+    void overlap_batch(const PixelBatch & batch, int x, int y, real * out);
+
+    /** Areas of the overlaps of a single pixel with the unit model cells (x, y) .. (x + count - 1, y) **/
+    void overlap_row(const Pixel & pixel, int x, int y, int count, real * out);
+
+    /** Instruction set selected at runtime for the batched kernels: "avx512", "avx2" or "scalar" **/
+    const char * overlap_kernel();
+
+    /** All instruction sets the kernels can use on this CPU, the selected one first and "scalar" always last **/
+    std::vector<std::string> overlap_kernels();
+
+    /** The same overlaps computed by the kernel of a given instruction set, to compare them with each other **/
+    void overlap_batch(const PixelBatch & batch, int x, int y, real * out, const std::string & kernel);
+    void overlap_row(const Pixel & pixel, int x, int y, int count, real * out, const std::string & kernel);
+}
+
+#endif //ANASTASIS_CPP_PIXELBATCH_H
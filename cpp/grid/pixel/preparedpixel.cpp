@@ -0,0 +1,93 @@
+#include "preparedpixel.h"
+
+namespace Astar {
+    /** A convex polygon with a fixed maximum number of vertices: a square clipped by four lines has at most eight **/
+    struct StackPolygon {
+        constexpr static int Capacity = 8;
+        std::array<real, Capacity> x;
+        std::array<real, Capacity> y;
+        int size;
+    };
+
+    PreparedPixel::PreparedPixel(const Pixel & pixel) {
+        const std::array<Point, 4> vertices = {pixel.a(), pixel.b(), pixel.c(), pixel.d()};
+        // Flip the normals if the vertices happen to go clockwise, so that they always point outwards
+        const real orientation = pixel.area() < 0 ? -1 : 1;
+        for (int i = 0; i < 4; ++i) {
+            const Point edge = vertices[(i + 1) % 4] - vertices[i];
+            this->normal_x_[i] = orientation * edge.y;
+            this->normal_y_[i] = -orientation * edge.x;
+            this->offset_[i] = this->normal_x_[i] * vertices[i].x + this->normal_y_[i] * vertices[i].y;
+        }
+    }
+
+    real PreparedPixel::overlap_unit_cell(int x, int y) const {
+        const real left = static_cast<real>(x);
+        const real bottom = static_cast<real>(y);
+
+        // Signed distances (scaled by edge length) of the bottom left cell corner from every edge
+        std::array<real, 4> base {};
+        bool inside = true;
+        for (int i = 0; i < 4; ++i) {
+            base[i] = this->normal_x_[i] * left + this->normal_y_[i] * bottom - this->offset_[i];
+            const real nx = this->normal_x_[i];
+            const real ny = this->normal_y_[i];
+            // The other three corners differ only by the components of the normal
+            const real lowest = base[i] + std::min(nx, 0.0) + std::min(ny, 0.0);
+            const real highest = base[i] + std::max(nx, 0.0) + std::max(ny, 0.0);
+            if (lowest >= 0) {
+                // The whole cell is outside of this edge
+                return 0;
+            }
+            inside &= (highest <= 0);
+        }
+        if (inside) {
+            return 1;
+        }
+
+        // Sutherland-Hodgman: clip the cell by every edge of the pixel, ping-ponging between two buffers
+        StackPolygon buffers[2] = {
+            {{left, left + 1, left + 1, left}, {bottom, bottom, bottom + 1, bottom + 1}, 4},
+            {{}, {}, 0},
+        };
+        int current = 0;
+        for (int i = 0; i < 4; ++i) {
+            const StackPolygon & in = buffers[current];
+            StackPolygon & out = buffers[1 - current];
+            out.size = 0;
+
+            const real nx = this->normal_x_[i];
+            const real ny = this->normal_y_[i];
+            const real offset = this->offset_[i];
+            for (int j = 0; j < in.size; ++j) {
+                const int k = (j + 1) % in.size;
+                const real sj = nx * in.x[j] + ny * in.y[j] - offset;
+                const real sk = nx * in.x[k] + ny * in.y[k] - offset;
+                if (sj <= 0) {
+                    out.x[out.size] = in.x[j];
+                    out.y[out.size] = in.y[j];
+                    ++out.size;
+                }
+                if ((sj < 0 && sk > 0) || (sj > 0 && sk < 0)) {
+                    const real t = sj / (sj - sk);
+                    out.x[out.size] = in.x[j] + t * (in.x[k] - in.x[j]);
+                    out.y[out.size] = in.y[j] + t * (in.y[k] - in.y[j]);
+                    ++out.size;
+                }
+            }
+            current = 1 - current;
+            if (out.size < 3) {
+                return 0;
+            }
+        }
+
+        // Run the shoelace algorithm on the clipped polygon, relative to the cell corner for better precision
+        const StackPolygon & polygon = buffers[current];
+        real shoelace = 0;
+        for (int j = 0; j < polygon.size; ++j) {
+            const int k = (j + 1) % polygon.size;
+            shoelace += (polygon.x[j] - left) * (polygon.y[k] - bottom) - (polygon.x[k] - left) * (polygon.y[j] - bottom);
+        }
+        return std::abs(shoelace) * 0.5;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef ANASTASIS_CPP_PREPAREDPIXEL_H
+#define ANASTASIS_CPP_PREPAREDPIXEL_H
+
+#include <array>
+
+#include "grid/pixel/pixel.h"
+
+namespace Astar {
+    /** A Pixel prepared for repeated overlap queries against unit model cells [x, x + 1) × [y, y + 1).
+     *  The outward normals of its four edges are computed once, so that a query is just a few
+     *  multiply-adds: cells completely outside one edge or completely inside all of them are resolved
+     *  immediately, the rest is clipped into a fixed-capacity polygon on the stack.
+     *  No heap allocation, no sorting and no trigonometry.
+     */
+    class PreparedPixel {
+    private:
+        // A point p lies inside the pixel iff normal_x_[i] * p.x + normal_y_[i] * p.y <= offset_[i] for all i
+        std::array<real, 4> normal_x_ {};
+        std::array<real, 4> normal_y_ {};
+        std::array<real, 4> offset_ {};
+    public:
+        PreparedPixel() = default;
+        explicit PreparedPixel(const Pixel & pixel);
+
+        /** Area of the overlap with the model cell whose bottom left corner is at (x, y) **/
+        [[nodiscard]] real overlap_unit_cell(int x, int y) const;
+    };
+}
+
+#endif //ANASTASIS_CPP_PREPAREDPIXEL_H
@@ -24,6 +24,15 @@ namespace Astar {
         pair<real> pixfrac_;
         real rotation_;
         pair<real> pixel_size_;
+
+        // The placement is affine, so every corner of the cells (as if pixfrac were 1) is origin + x edge_x + y edge_y.
+        // Updated by anything that moves, scales or rotates the grid, so const access never writes
+        // and the grid can be shared between threads as it is.
+        Point origin_ = {0, 0};
+        Point edge_x_ = {0, 0};
+        Point edge_y_ = {0, 0};
+
+        void update_axes();
     public:
         constexpr static real NegligibleOverlap = 1e-15;
 
@@ -43,6 +52,10 @@ namespace Astar {
         [[nodiscard]] inline pair<real> physical_size() const { return this->physical_size_; }
         [[nodiscard]] inline real rotation() const { return this->rotation_; }
         [[nodiscard]] inline pair<real> pixfrac() const { return this->pixfrac_; }
+        /** Is the grid aligned with the world axes, up to a rotation by a multiple of right angle? **/
+        [[nodiscard]] inline bool is_orthogonal() const {
+            return (std::abs(std::sin(this->rotation_)) < 1e-10) || (std::abs(std::cos(this->rotation_)) < 1e-10);
+        }
 
         [[nodiscard]] inline real pixel_area(int col, int row) const {
             (void) col;
@@ -62,6 +75,9 @@ namespace Astar {
         [[nodiscard]] Pixel grid_pixel(unsigned int x, unsigned int y) const;
         [[nodiscard]] Pixel world_pixel(unsigned int x, unsigned int y) const;
 
+        /** World position of the lattice corner (x, y), x in [0, W], y in [0, H] **/
+        [[nodiscard]] Point world_corner(unsigned int x, unsigned int y) const;
+
         //[[nodiscard]] std::vector<Overlap4D> onto_canonical(const ModelImage & canonical) const;
         //[[nodiscard]] Eigen::SparseMatrix<real> matrix_canonical(const ModelImage & canonical) const;
 
@@ -16,7 +16,9 @@ namespace Astar {
             pixfrac.first * physical_size.first / static_cast<real>(grid_size.first),
             pixfrac.second * physical_size.second / static_cast<real>(grid_size.second)
         })
-    { }
+    {
+        this->update_axes();
+    }
 
     template<class Derived>
     PlacedGrid<Derived> PlacedGrid<Derived>::from_pixel_size(Point centre,
@@ -60,18 +62,53 @@ namespace Astar {
 
     template<class Derived>
     Pixel PlacedGrid<Derived>::world_pixel(unsigned int x, unsigned int y) const {
-        Pixel raw = this->grid_pixel(x, y);
+        /** Take the four surrounding corners from the affine placement instead of rotating every corner again.
+         *  If pixfrac shrinks the pixel, move the corners towards the centre along the (rotated) grid axes. **/
+        const Point a = this->world_corner(x, y);
+        const Point b = this->world_corner(x + 1, y);
+        const Point c = this->world_corner(x + 1, y + 1);
+        const Point d = this->world_corner(x, y + 1);
+
+        const real shrink_x = this->pixel_size_.first * this->pixfrac_.first * this->width() / this->physical_size_.first;
+        const real shrink_y = this->pixel_size_.second * this->pixfrac_.second * this->height() / this->physical_size_.second;
+        if ((shrink_x == 1) && (shrink_y == 1)) {
+            return Pixel(a, b, d, c);
+        }
+
+        const Point half_u = (b - a) * (0.5 * shrink_x);
+        const Point half_v = (d - a) * (0.5 * shrink_y);
+        const Point centre = (a + c) * 0.5;
         return Pixel(
-            this->centre_ + raw.a().rotated(this->rotation_),
-            this->centre_ + raw.b().rotated(this->rotation_),
-            this->centre_ + raw.d().rotated(this->rotation_),
-            this->centre_ + raw.c().rotated(this->rotation_)
+            centre - half_u - half_v,
+            centre + half_u - half_v,
+            centre - half_u + half_v,
+            centre + half_u + half_v
         );
     }
 
+    template<class Derived>
+    Point PlacedGrid<Derived>::world_corner(unsigned int x, unsigned int y) const {
+        return this->origin_ + this->edge_x_ * static_cast<real>(x) + this->edge_y_ * static_cast<real>(y);
+    }
+
+    template<class Derived>
+    void PlacedGrid<Derived>::update_axes() {
+        const real sina = std::sin(this->rotation_);
+        const real cosa = std::cos(this->rotation_);
+        const real step_x = this->physical_size_.first / static_cast<real>(this->width());
+        const real step_y = this->physical_size_.second / static_cast<real>(this->height());
+        const real half_x = 0.5 * this->physical_size_.first;
+        const real half_y = 0.5 * this->physical_size_.second;
+
+        this->edge_x_ = Point(step_x * cosa, step_x * sina);
+        this->edge_y_ = Point(-step_y * sina, step_y * cosa);
+        this->origin_ = Point(this->centre_.x - half_x * cosa + half_y * sina, this->centre_.y - half_x * sina - half_y * cosa);
+    }
+
     template<class Derived>
     Derived & PlacedGrid<Derived>::set_centre(Point centre) {
         this->centre_ = centre;
+        this->update_axes();
         return static_cast<Derived &>(*this);
     }
 
@@ -82,6 +119,7 @@ namespace Astar {
                 this->pixfrac_.first * this->physical_size_.first / static_cast<real>(this->size().first),
                 this->pixfrac_.second * this->physical_size_.second / static_cast<real>(this->size().second)
         };
+        this->update_axes();
         return static_cast<Derived &>(*this);
     }
 
@@ -141,10 +179,10 @@ namespace Astar {
 
     template<class Derived>
     void PlacedGrid<Derived>::print_corners() const {
-        Point bottomleft = this->world_pixel(0, 0).a();
-        Point bottomright = this->world_pixel(this->width() - 1, 0).b();
-        Point topleft = this->world_pixel(0, this->height() - 1).d();
-        Point topright = this->world_pixel(this->width() - 1, this->height() - 1).c();
+        Point bottomleft = this->world_corner(0, 0);
+        Point bottomright = this->world_corner(this->width(), 0);
+        Point topleft = this->world_corner(0, this->height());
+        Point topright = this->world_corner(this->width(), this->height());
         fmt::print("Grid corners: {}, {}, {}, {}\n",
                    bottomleft, bottomright, topleft, topright);
     }
@@ -152,12 +190,14 @@ namespace Astar {
     template<class Derived>
     Derived & PlacedGrid<Derived>::operator+=(Point shift) {
         this->centre_ += shift;
+        this->update_axes();
         return static_cast<Derived &>(*this);
     }
 
     template<class Derived>
     Derived & PlacedGrid<Derived>::operator-=(Point shift) {
         this->centre_ -= shift;
+        this->update_axes();
         return static_cast<Derived &>(*this);
     }
 
@@ -172,18 +212,21 @@ namespace Astar {
         this->physical_size_.second *= scale.second;
         this->pixel_size_.first *= scale.first;
         this->pixel_size_.second *= scale.second;
+        this->update_axes();
         return static_cast<Derived &>(*this);
     }
 
     template<class Derived>
     Derived & PlacedGrid<Derived>::operator<<=(real angle) {
         this->rotation_ -= angle;
+        this->update_axes();
         return static_cast<Derived &>(*this);
     }
 
     template<class Derived>
     Derived & PlacedGrid<Derived>::operator>>=(real angle) {
         this->rotation_ += angle;
+        this->update_axes();
         return static_cast<Derived &>(*this);
     }
 
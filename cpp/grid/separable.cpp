@@ -0,0 +1,68 @@
+#include "separable.h"
+
+namespace Astar {
+    namespace {
+        /** Build a (cells × intervals) matrix of overlaps of each interval with unit cells [c, c + 1) **/
+        RealSparseMatrix interval_weights(int cells, const std::vector<pair<real>> & intervals) {
+            std::vector<Eigen::Triplet<real>> triplets;
+            triplets.reserve(2 * intervals.size());
+
+            for (int i = 0; i < static_cast<int>(intervals.size()); ++i) {
+                auto [low, high] = intervals[i];
+                int first = std::max(static_cast<int>(std::floor(low)), 0);
+                int last = std::min(static_cast<int>(std::ceil(high)), cells);
+                for (int c = first; c < last; ++c) {
+                    real weight = interval_overlap({low, high}, {c, c + 1});
+                    if (weight > DetectorImage::NegligibleOverlap) {
+                        triplets.emplace_back(c, i, weight);
+                    }
+                }
+            }
+
+            RealSparseMatrix weights(cells, static_cast<long>(intervals.size()));
+            weights.setFromTriplets(triplets.begin(), triplets.end());
+            return weights;
+        }
+
+        /** Extent of a pixel along the x or y world axis **/
+        pair<real> extent(const Pixel & pixel, bool vertical) {
+            auto coordinate = [=](Point p) { return vertical ? p.y : p.x; };
+            auto values = {coordinate(pixel.a()), coordinate(pixel.b()), coordinate(pixel.c()), coordinate(pixel.d())};
+            return {std::min(values), std::max(values)};
+        }
+    }
+
+    SeparableWeights::SeparableWeights(pair<int> model_size, const DetectorImage & image):
+        transposed_(std::abs(std::sin(image.rotation())) > std::abs(std::cos(image.rotation())))
+    {
+        if (!image.is_orthogonal()) {
+            throw std::invalid_argument(fmt::format("Separable weights require an orthogonal grid, rotation is {}",
+                                                    image.rotation()));
+        }
+
+        // World x follows detector columns (or rows if transposed), world y follows the other one,
+        // so it suffices to look at the first row and the first column of the detector
+        std::vector<pair<real>> columns, rows;
+        columns.reserve(image.width());
+        rows.reserve(image.height());
+        for (int col = 0; col < image.width(); ++col) {
+            columns.push_back(extent(image.world_pixel(col, 0), this->transposed_));
+        }
+        for (int row = 0; row < image.height(); ++row) {
+            rows.push_back(extent(image.world_pixel(0, row), !this->transposed_));
+        }
+
+        this->horizontal_ = interval_weights(model_size.first, this->transposed_ ? rows : columns);
+        this->vertical_ = interval_weights(model_size.second, this->transposed_ ? columns : rows);
+    }
+
+    RealMatrix SeparableWeights::apply(const Matrix & data) const {
+        // Two sparse passes instead of a quadruple loop: first along the vertical axis, then the horizontal one
+        const RealMatrix values = data.cast<real>();
+        if (this->transposed_) {
+            return (this->vertical_ * values.transpose()) * this->horizontal_.transpose();
+        } else {
+            return (this->vertical_ * values) * this->horizontal_.transpose();
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef ANASTASIS_CPP_SEPARABLE_H
+#define ANASTASIS_CPP_SEPARABLE_H
+
+#include "utils/eigen.h"
+#include "grid/detectorimage.h"
+
+namespace Astar {
+    /** Overlap weights of an orthogonal (aligned or right-angle-rotated) exposure with the unit model cells.
+     *  In that case every world pixel is an aligned rectangle and its overlap with a model cell is simply
+     *  a product of 1D interval overlaps, so the weights factorise into a horizontal and a vertical part:
+     *
+     *      overlap(col, row, x, y) = horizontal(x, u) * vertical(y, v)
+     *
+     *  where (u, v) = (col, row) for rotations by 0° or 180° and (row, col) for 90° or 270° (`transposed`).
+     */
+    class SeparableWeights {
+    private:
+        RealSparseMatrix horizontal_;
+        RealSparseMatrix vertical_;
+        bool transposed_;
+    public:
+        SeparableWeights(pair<int> model_size, const DetectorImage & image);
+
+        /** Model width × number of detector columns (or rows if transposed) **/
+        [[nodiscard]] const RealSparseMatrix & horizontal() const { return this->horizontal_; }
+        /** Model height × number of detector rows (or columns if transposed) **/
+        [[nodiscard]] const RealSparseMatrix & vertical() const { return this->vertical_; }
+        [[nodiscard]] bool transposed() const { return this->transposed_; }
+
+        /** Total overlap of every model cell with every detector pixel, weighted by its value:
+         *  a matrix M such that M(y, x) = sum over col, row of overlap(col, row, x, y) * data(row, col) **/
+        [[nodiscard]] RealMatrix apply(const Matrix & data) const;
+    };
+}
+
+#endif //ANASTASIS_CPP_SEPARABLE_H
@@ -0,0 +1,262 @@
+#include <map>
+
+#include "stencilmatrix.h"
+#include "grid/pixel/pixelbatch.h"
+#include "utils/parallel.h"
+
+namespace Astar {
+    StencilMatrix::StencilMatrix(pair<int> model_size, const std::vector<DetectorImage> & exposures,
+                                 real tolerance, int threads):
+        AbstractGrid(model_size),
+        pattern_offsets_(1, 0),
+        threads_(threads)
+    {
+        for (auto && image: exposures) {
+            Exposure exposure {image.width(), image.height(), this->rows_, std::nullopt, std::nullopt, {}, {}};
+            if (image.is_orthogonal()) {
+                exposure.separable.emplace(model_size, image);
+            } else {
+                this->add_patterned(image, tolerance, exposure);
+            }
+            this->rows_ += image.count();
+            this->exposures_.push_back(std::move(exposure));
+        }
+    }
+
+    void StencilMatrix::add_patterned(const DetectorImage & image, real tolerance, Exposure & exposure) {
+        // Patterns are identified by their offsets and weights quantised to the tolerance
+        std::map<std::vector<long long>, int> known;
+        std::vector<long long> key;
+        std::vector<Entry> pattern;
+        std::vector<real> overlaps(this->width());
+        const std::size_t first_pattern = this->pattern_count();
+        const std::size_t first_entry = this->entries_.size();
+        std::size_t nonzeros = 0;
+
+        exposure.anchors.resize(image.count());
+        exposure.patterns.resize(image.count());
+        for (int row = 0; row < image.height(); ++row) {
+            for (int col = 0; col < image.width(); ++col) {
+                const Pixel pixel = image.world_pixel(col, row);
+                const Box bounds = pixel.bounding_box();
+                const int left = std::max(bounds.left, 0);
+                const int right = std::min(bounds.right, this->width());
+                const int bottom = (left < right) ? std::max(bounds.bottom, 0) : 0;
+                const int top = (left < right) ? std::min(bounds.top, this->height()) : 0;
+
+                // Collect the overlaps in absolute cell coordinates first, then make them relative to the anchor
+                pattern.clear();
+                for (int y = bottom; y < top; ++y) {
+                    overlap_row(pixel, left, y, right - left, overlaps.data());
+                    for (int x = left; x < right; ++x) {
+                        if (overlaps[x - left] > DetectorImage::NegligibleOverlap) {
+                            pattern.push_back({x, y, overlaps[x - left]});
+                        }
+                    }
+                }
+
+                int anchor_x = 0;
+                int anchor_y = 0;
+                if (!pattern.empty()) {
+                    anchor_x = std::min_element(pattern.begin(), pattern.end(),
+                                                [](const Entry & a, const Entry & b) { return a.dx < b.dx; })->dx;
+                    anchor_y = pattern.front().dy;
+                }
+
+                key.clear();
+                for (auto && entry: pattern) {
+                    entry.dx -= anchor_x;
+                    entry.dy -= anchor_y;
+                    key.push_back(entry.dx);
+                    key.push_back(entry.dy);
+                    key.push_back(std::llround(entry.weight / tolerance));
+                }
+
+                auto [found, inserted] = known.try_emplace(key, static_cast<int>(this->pattern_count()));
+                if (inserted) {
+                    this->entries_.insert(this->entries_.end(), pattern.begin(), pattern.end());
+                    this->pattern_offsets_.push_back(static_cast<int>(this->entries_.size()));
+                }
+
+                const int index = image.width() * row + col;
+                exposure.anchors[index] = this->width() * anchor_y + anchor_x;
+                exposure.patterns[index] = found->second;
+                nonzeros += pattern.size();
+            }
+        }
+
+        // Keep the patterns only if they take less memory than the explicit rows they describe
+        const std::size_t patterned = (this->pattern_count() - first_pattern) * sizeof(int) +
+                                      (this->entries_.size() - first_entry) * sizeof(Entry) +
+                                      (exposure.anchors.size() + exposure.patterns.size()) * sizeof(int);
+        const std::size_t rows = nonzeros * (sizeof(int) + sizeof(storage)) + (image.count() + 1) * sizeof(int);
+        if (patterned <= rows) {
+            return;
+        }
+
+        // Expand every pixel's pattern into its row directly in compressed form, then drop the patterns
+        SparseMatrix matrix(image.count(), this->count());
+        matrix.resizeNonZeros(static_cast<Eigen::Index>(nonzeros));
+        int * const outer = matrix.outerIndexPtr();
+        int * const inner = matrix.innerIndexPtr();
+        storage * const values = matrix.valuePtr();
+        outer[0] = 0;
+        for (std::size_t pixel = 0; pixel < exposure.patterns.size(); ++pixel) {
+            const int anchor = exposure.anchors[pixel];
+            const int pattern = exposure.patterns[pixel];
+            int position = outer[pixel];
+            for (int e = this->pattern_offsets_[pattern]; e < this->pattern_offsets_[pattern + 1]; ++e) {
+                const Entry & entry = this->entries_[e];
+                inner[position] = anchor + this->width() * entry.dy + entry.dx;
+                values[position] = static_cast<storage>(entry.weight);
+                ++position;
+            }
+            outer[pixel + 1] = position;
+        }
+
+        this->entries_.resize(first_entry);
+        this->pattern_offsets_.resize(first_pattern + 1);
+        exposure.anchors = {};
+        exposure.patterns = {};
+        exposure.rows.emplace(std::move(matrix));
+    }
+
+    std::size_t StencilMatrix::nonzeros() const {
+        std::size_t nonzeros = 0;
+        for (auto && exposure: this->exposures_) {
+            if (exposure.separable) {
+                // Every detector pixel overlaps the product of its horizontal and vertical stencils
+                nonzeros += static_cast<std::size_t>(exposure.separable->horizontal().nonZeros()) *
+                            static_cast<std::size_t>(exposure.separable->vertical().nonZeros());
+            } else if (exposure.rows) {
+                nonzeros += static_cast<std::size_t>(exposure.rows->nonZeros());
+            } else {
+                for (int pattern: exposure.patterns) {
+                    nonzeros += this->pattern_offsets_[pattern + 1] - this->pattern_offsets_[pattern];
+                }
+            }
+        }
+        return nonzeros;
+    }
+
+    std::size_t StencilMatrix::bytes() const {
+        std::size_t bytes = this->pattern_offsets_.size() * sizeof(int) + this->entries_.size() * sizeof(Entry);
+        for (auto && exposure: this->exposures_) {
+            if (exposure.separable) {
+                for (const RealSparseMatrix * weights: {&exposure.separable->horizontal(), &exposure.separable->vertical()}) {
+                    bytes += weights->nonZeros() * (sizeof(real) + sizeof(int)) + (weights->cols() + 1) * sizeof(int);
+                }
+            } else if (exposure.rows) {
+                bytes += exposure.rows->nonZeros() * (sizeof(storage) + sizeof(int)) + (exposure.rows->rows() + 1) * sizeof(int);
+            } else {
+                bytes += (exposure.anchors.size() + exposure.patterns.size()) * sizeof(int);
+            }
+        }
+        return bytes;
+    }
+
+    std::size_t StencilMatrix::explicit_bytes() const {
+        return this->nonzeros() * (sizeof(int) + sizeof(storage)) + (this->rows_ + 1) * sizeof(int);
+    }
+
+    RealVector StencilMatrix::multiply(const RealVector & model) const {
+        if (model.size() != this->cols()) {
+            throw std::invalid_argument(fmt::format("Model vector has {} entries, expected {}", model.size(), this->cols()));
+        }
+
+        RealVector out(this->rows_);
+        for (auto && exposure: this->exposures_) {
+            const Eigen::Index count = static_cast<Eigen::Index>(exposure.width) * exposure.height;
+            if (exposure.separable) {
+                // The transpose of SeparableWeights::apply: D = V^T M H, transposed back for right-angle rotations
+                const auto & weights = *exposure.separable;
+                const RealMatrix image = model.reshaped<Eigen::RowMajor>(this->height(), this->width());
+                const RealMatrix values = (weights.vertical().transpose() * image) * weights.horizontal();
+                if (weights.transposed()) {
+                    out.segment(exposure.offset, count) = values.transpose().reshaped<Eigen::RowMajor>();
+                } else {
+                    out.segment(exposure.offset, count) = values.reshaped<Eigen::RowMajor>();
+                }
+            } else if (exposure.rows) {
+                const SparseMatrix & matrix = *exposure.rows;
+                real * const target = out.data() + exposure.offset;
+                parallel_for(0, static_cast<int>(count), this->threads_, [&](int, int begin, int end) {
+                    for (int pixel = begin; pixel < end; ++pixel) {
+                        real sum = 0;
+                        for (SparseMatrix::InnerIterator it(matrix, pixel); it; ++it) {
+                            sum += static_cast<real>(it.value()) * model[it.col()];
+                        }
+                        target[pixel] = sum;
+                    }
+                });
+            } else {
+                real * const target = out.data() + exposure.offset;
+                parallel_for(0, static_cast<int>(count), this->threads_, [&](int, int begin, int end) {
+                    for (int pixel = begin; pixel < end; ++pixel) {
+                        const int anchor = exposure.anchors[pixel];
+                        const int pattern = exposure.patterns[pixel];
+                        real sum = 0;
+                        for (int e = this->pattern_offsets_[pattern]; e < this->pattern_offsets_[pattern + 1]; ++e) {
+                            const Entry & entry = this->entries_[e];
+                            sum += entry.weight * model[anchor + this->width() * entry.dy + entry.dx];
+                        }
+                        target[pixel] = sum;
+                    }
+                });
+            }
+        }
+        return out;
+    }
+
+    RealVector StencilMatrix::multiply_transposed(const RealVector & detector) const {
+        if (detector.size() != this->rows_) {
+            throw std::invalid_argument(fmt::format("Detector vector has {} entries, expected {}", detector.size(), this->rows_));
+        }
+
+        RealVector out = RealVector::Zero(this->cols());
+        for (auto && exposure: this->exposures_) {
+            const Eigen::Index count = static_cast<Eigen::Index>(exposure.width) * exposure.height;
+            if (exposure.separable) {
+                const auto & weights = *exposure.separable;
+                const RealMatrix values = detector.segment(exposure.offset, count).reshaped<Eigen::RowMajor>(
+                    exposure.height, exposure.width
+                );
+                const RealMatrix image = weights.transposed()
+                    ? RealMatrix((weights.vertical() * values.transpose()) * weights.horizontal().transpose())
+                    : RealMatrix((weights.vertical() * values) * weights.horizontal().transpose());
+                out += image.reshaped<Eigen::RowMajor>();
+            } else if (exposure.rows) {
+                const SparseMatrix & matrix = *exposure.rows;
+                const real * const source = detector.data() + exposure.offset;
+                for (int pixel = 0; pixel < static_cast<int>(count); ++pixel) {
+                    for (SparseMatrix::InnerIterator it(matrix, pixel); it; ++it) {
+                        out[it.col()] += static_cast<real>(it.value()) * source[pixel];
+                    }
+                }
+            } else {
+                // Scatter into per-thread buffers, which are then summed in order
+                const int threads = resolve_threads(this->threads_);
+                std::vector<RealVector> buffers(threads);
+                const real * const source = detector.data() + exposure.offset;
+                parallel_for(0, static_cast<int>(count), threads, [&](int thread, int begin, int end) {
+                    RealVector & buffer = buffers[thread];
+                    buffer.setZero(this->cols());
+                    for (int pixel = begin; pixel < end; ++pixel) {
+                        const int anchor = exposure.anchors[pixel];
+                        const int pattern = exposure.patterns[pixel];
+                        for (int e = this->pattern_offsets_[pattern]; e < this->pattern_offsets_[pattern + 1]; ++e) {
+                            const Entry & entry = this->entries_[e];
+                            buffer[anchor + this->width() * entry.dy + entry.dx] += entry.weight * source[pixel];
+                        }
+                    }
+                });
+                for (auto && buffer: buffers) {
+                    if (buffer.size() > 0) {
+                        out += buffer;
+                    }
+                }
+            }
+        }
+        return out;
+    }
+}
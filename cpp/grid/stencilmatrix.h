@@ -0,0 +1,71 @@
+#ifndef ANASTASIS_CPP_STENCILMATRIX_H
+#define ANASTASIS_CPP_STENCILMATRIX_H
+
+#include <optional>
+#include <vector>
+
+#include "utils/eigen.h"
+#include "grid/detectorimage.h"
+#include "grid/separable.h"
+
+namespace Astar {
+    /** Compressed overlap matrix of a set of exposures (stacked vertically, like the overlap matrices),
+     *  storing only the distinct overlap patterns instead of every weight.
+     *
+     *  Orthogonal exposures, which includes every shifted or dithered one, are kept as their separable weights:
+     *  two 1D stencil matrices of the size of the model, whatever the number of detector pixels.
+     *  Any other exposure stores, for every detector pixel, the model cell its pattern is anchored at
+     *  and the index of the pattern, a list of (dx, dy, weight) relative to the anchor. Pixels whose weights agree
+     *  up to `tolerance` share a pattern, so translation-invariant grids need only a few of them.
+     *  A rotated lattice that is not commensurate with the model gives almost every pixel a pattern of its own,
+     *  and such an exposure is kept as its explicit compressed rows instead, which are never larger.
+     */
+    class StencilMatrix: public virtual AbstractGrid {
+    private:
+        struct Entry {
+            int dx;
+            int dy;
+            real weight;
+        };
+
+        struct Exposure {
+            int width;
+            int height;
+            Eigen::Index offset;
+            std::optional<SeparableWeights> separable;
+            std::optional<SparseMatrix> rows;   // Explicit overlap rows, if the patterns would not save memory
+            std::vector<int> anchors;       // w * y + x of the anchor cell of every detector pixel
+            std::vector<int> patterns;      // pattern index of every detector pixel
+        };
+
+        std::vector<Exposure> exposures_;
+        std::vector<int> pattern_offsets_;  // Entries of pattern p are entries_[pattern_offsets_[p] .. pattern_offsets_[p + 1])
+        std::vector<Entry> entries_;
+        Eigen::Index rows_ = 0;
+        int threads_;
+
+        void add_patterned(const DetectorImage & image, real tolerance, Exposure & exposure);
+    public:
+        StencilMatrix(pair<int> model_size, const std::vector<DetectorImage> & exposures,
+                      real tolerance = 1e-12, int threads = 1);
+
+        /** Total number of detector pixels over all exposures **/
+        [[nodiscard]] Eigen::Index rows() const { return this->rows_; }
+        /** Number of model cells **/
+        [[nodiscard]] Eigen::Index cols() const { return this->count(); }
+
+        [[nodiscard]] std::size_t pattern_count() const { return this->pattern_offsets_.size() - 1; }
+        /** Number of nonzeros of the equivalent explicit matrix, counting every product of separable weights **/
+        [[nodiscard]] std::size_t nonzeros() const;
+        /** Memory taken by the stencils, and by the equivalent compressed sparse matrix **/
+        [[nodiscard]] std::size_t bytes() const;
+        [[nodiscard]] std::size_t explicit_bytes() const;
+
+        /** A * model **/
+        [[nodiscard]] RealVector multiply(const RealVector & model) const;
+        /** A^T * detector **/
+        [[nodiscard]] RealVector multiply_transposed(const RealVector & detector) const;
+    };
+}
+
+#endif //ANASTASIS_CPP_STENCILMATRIX_H
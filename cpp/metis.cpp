@@ -1,5 +1,6 @@
 #include "utils/resample.h"
 #include "types/types.h"
+#include "grid/manifest.h"
 
 using namespace Astar;
 
@@ -58,7 +59,10 @@ ModelImage prepare_direct(
 
 void print_usage(int code) {
     fmt::print("Usage: metis <filename> model_size_x model_size_y pixfrac_x pixfrac_y\n");
+    fmt::print("       metis --manifest <manifest> model_size_x model_size_y\n");
     fmt::print("<filename>          path to an 8-bit bmp file\n");
+    fmt::print("<manifest>          list of exposures to drizzle one at a time, one per line: filename centre_x "
+               "centre_y physical_width physical_height rotation pixfrac_x pixfrac_y\n");
     fmt::print("model_size_x        int > 0, number of pixels in horizontal direction for downsampled images\n");
     fmt::print("model_size_y        int > 0, number of pixels in vertical direction for downsampled images\n");
     fmt::print("pixfrac_x           float (0, 1], pixel fraction used in drizzling, horizontal direction "
@@ -72,6 +76,24 @@ int main(int argc, char * argv[]) {
     std::string exec_name = argv[0];
     std::vector<std::string> args(argv, argv + argc);
 
+    if ((argc > 1) && (args[1] == "--manifest")) {
+        try {
+            if (argc != 5) {
+                print_usage(0);
+            }
+            // Only a few exposures are in memory at any time, however many the manifest lists
+            ModelImage output = drizzle_manifest(args[2], {std::stoi(args[3]), std::stoi(args[4])}, 0);
+            output.save_npy("./out/drizzled.npy");
+        } catch (std::invalid_argument & exc) {
+            fmt::print("Aborting due to invalid argument type: {}\n", exc.what());
+            print_usage(1);
+        } catch (std::runtime_error & exc) {
+            fmt::print("Aborting: {}\n", exc.what());
+            std::exit(3);
+        }
+        return 0;
+    }
+
     pair<int> model_size;
     pair<real> pixfrac;
     try {
@@ -0,0 +1,160 @@
+#include "cgls.h"
+
+namespace Astar {
+    Cgls::Cgls(Eigen::Index rows, Eigen::Index cols, Product forward, Product adjoint):
+        rows_(rows),
+        cols_(cols),
+        forward_(std::move(forward)),
+        adjoint_(std::move(adjoint))
+    {}
+
+    Cgls::Cgls(const SparseMatrix & matrix):
+        Cgls(
+            matrix.rows(), matrix.cols(),
+            [&matrix](const RealVector & x) -> RealVector { return (matrix * x.cast<storage>()).cast<real>(); },
+            [&matrix](const RealVector & y) -> RealVector { return (matrix.transpose() * y.cast<storage>()).cast<real>(); }
+        )
+    {}
+
+    Cgls::Cgls(const BlockSparseMatrix & matrix):
+        Cgls(
+            matrix.rows(), matrix.cols(),
+            [&matrix](const RealVector & x) { return matrix.multiply(x); },
+            [&matrix](const RealVector & y) { return matrix.multiply_transposed(y); }
+        )
+    {}
+
+    Cgls::Cgls(const StencilMatrix & matrix):
+        Cgls(
+            matrix.rows(), matrix.cols(),
+            [&matrix](const RealVector & x) { return matrix.multiply(x); },
+            [&matrix](const RealVector & y) { return matrix.multiply_transposed(y); }
+        )
+    {}
+
+    Cgls::Cgls(const DrizzleOperator & drizzle):
+        Cgls(
+            drizzle.rows(), drizzle.cols(),
+            [&drizzle](const RealVector & x) { return drizzle.forward(x); },
+            [&drizzle](const RealVector & y) { return drizzle.adjoint(y); }
+        )
+    {}
+
+    Cgls & Cgls::set_weights(const RealVector & weights) {
+        if (weights.size() != this->rows_) {
+            throw std::invalid_argument(fmt::format("Expected {} weights, got {}", this->rows_, weights.size()));
+        }
+        if (weights.minCoeff() < 0) {
+            throw std::invalid_argument("Weights must not be negative");
+        }
+        this->weights_ = weights;
+        return *this;
+    }
+
+    Cgls & Cgls::set_damping(real damping) {
+        this->damping_ = damping;
+        return *this;
+    }
+
+    Cgls & Cgls::set_tolerance(real tolerance) {
+        this->tolerance_ = tolerance;
+        return *this;
+    }
+
+    Cgls & Cgls::set_max_iterations(int max_iterations) {
+        this->max_iterations_ = max_iterations;
+        return *this;
+    }
+
+    Cgls & Cgls::set_verbose(bool verbose) {
+        this->verbose_ = verbose;
+        return *this;
+    }
+
+    Cgls & Cgls::set_jacobi_preconditioner(bool jacobi) {
+        this->jacobi_ = jacobi;
+        return *this;
+    }
+
+    RealVector Cgls::jacobi_preconditioner() const {
+        const RealVector ones = RealVector::Ones(this->rows_);
+        const RealVector coverage = this->adjoint_(this->weights_.size() > 0 ? this->weights_ : ones);
+
+        // Cells not covered by any pixel are not touched by the solver at all, leave them unscaled
+        return coverage.unaryExpr([this](real c) {
+            return (c + this->damping_ > 0) ? 1.0 / (c + this->damping_) : 1.0;
+        });
+    }
+
+    RealVector Cgls::solve(const RealVector & observations) {
+        return this->solve(observations, RealVector::Zero(this->cols_));
+    }
+
+    RealVector Cgls::solve(const RealVector & observations, const RealVector & initial) {
+        if (observations.size() != this->rows_) {
+            throw std::invalid_argument(fmt::format("Expected {} observations, got {}", this->rows_, observations.size()));
+        }
+        if (initial.size() != this->cols_) {
+            throw std::invalid_argument(fmt::format("Expected initial guess of size {}, got {}", this->cols_, initial.size()));
+        }
+
+        const bool weighted = this->weights_.size() > 0;
+        const bool preconditioned = this->jacobi_;
+        const RealVector preconditioner = preconditioned ? this->jacobi_preconditioner() : RealVector();
+        auto weigh = [&](const RealVector & v) -> RealVector { return weighted ? RealVector(this->weights_.cwiseProduct(v)) : v; };
+        auto precondition = [&](const RealVector & v) -> RealVector {
+            return preconditioned ? RealVector(preconditioner.cwiseProduct(v)) : v;
+        };
+        auto weighted_norm = [&](const RealVector & v) {
+            return std::sqrt(weighted ? v.cwiseProduct(this->weights_).dot(v) : v.squaredNorm());
+        };
+
+        this->history_.clear();
+        this->converged_ = false;
+
+        // Preconditioned conjugate gradients on A^T W A x + damping x = A^T W b, with the residual r = b - A x
+        // of the observations updated recursively rather than recomputed
+        RealVector x = initial;
+        RealVector r = observations - this->forward_(x);
+        RealVector s = this->adjoint_(weigh(r)) - this->damping_ * x;
+        RealVector z = precondition(s);
+        RealVector p = z;
+        real gamma = s.dot(z);
+        const real initial_norm = s.norm();
+
+        if (initial_norm == 0) {
+            this->converged_ = true;
+            return x;
+        }
+
+        for (int iteration = 1; iteration <= this->max_iterations_; ++iteration) {
+            const RealVector q = this->forward_(p);
+            const real delta = weighted_norm(q) * weighted_norm(q) + this->damping_ * p.squaredNorm();
+            if (delta <= 0) {
+                break;
+            }
+
+            const real alpha = gamma / delta;
+            x += alpha * p;
+            r -= alpha * q;
+            s = this->adjoint_(weigh(r)) - this->damping_ * x;
+            z = precondition(s);
+
+            const real gamma_next = s.dot(z);
+            const CglsIteration progress {iteration, weighted_norm(r), s.norm() / initial_norm};
+            this->history_.push_back(progress);
+            if (this->verbose_) {
+                fmt::print("CGLS iteration {:4d}: residual {:.6e}, relative normal residual {:.6e}\n",
+                           progress.iteration, progress.residual, progress.normal_residual);
+            }
+            if (progress.normal_residual < this->tolerance_) {
+                this->converged_ = true;
+                break;
+            }
+
+            p = z + (gamma_next / gamma) * p;
+            gamma = gamma_next;
+        }
+        return x;
+    }
+}
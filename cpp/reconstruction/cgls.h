@@ -0,0 +1,83 @@
+#ifndef ANASTASIS_CPP_CGLS_H
+#define ANASTASIS_CPP_CGLS_H
+
+#include <functional>
+#include <vector>
+
+#include "utils/eigen.h"
+#include "utils/blocksparse.h"
+#include "grid/drizzleoperator.h"
+#include "grid/stencilmatrix.h"
+
+namespace Astar {
+    /** Progress of the solver after a single iteration **/
+    struct CglsIteration {
+        int iteration;
+        real residual;              // ||W^1/2 (b - A x)||
+        real normal_residual;       // ||A^T W (b - A x) - damping * x||, relative to its initial value
+    };
+
+    /** Conjugate gradients on the normal equations (CGLS) for the weighted, damped least squares problem
+     *
+     *      minimise ||W^1/2 (A x - b)||^2 + damping * ||x||^2
+     *
+     *  where W is a diagonal matrix of inverse variances of the observations. A is only ever applied
+     *  through its products, so the same solver works with the stacked overlap matrix as well as with
+     *  a matrix-free DrizzleOperator, whichever is available. Never forms A^T W A: every iteration costs
+     *  one forward and one adjoint product and the detector residual is updated recursively.
+     *
+     *  Optionally preconditioned by the Jacobi (diagonal) preconditioner estimated from the coverage map
+     *  A^T W 1, which is the exact diagonal of A^T W A for overlaps that are either 0 or 1.
+     */
+    class Cgls {
+    public:
+        typedef std::function<RealVector(const RealVector &)> Product;
+    private:
+        Eigen::Index rows_;
+        Eigen::Index cols_;
+        Product forward_;
+        Product adjoint_;
+
+        RealVector weights_;            // Inverse variances of the observations, empty means unit weights
+        bool jacobi_ = false;           // Precondition by the inverse of the damped coverage map
+        real damping_ = 0;
+        real tolerance_ = 1e-6;
+        int max_iterations_ = 100;
+        bool verbose_ = false;
+
+        std::vector<CglsIteration> history_;
+        bool converged_ = false;
+
+        /** Diagonal of the inverse of the Jacobi preconditioner, for the current weights and damping **/
+        [[nodiscard]] RealVector jacobi_preconditioner() const;
+    public:
+        Cgls(Eigen::Index rows, Eigen::Index cols, Product forward, Product adjoint);
+        /** Solve with an explicit (stacked) overlap matrix, which must outlive the solver **/
+        explicit Cgls(const SparseMatrix & matrix);
+        /** Solve with per-exposure blocks of the overlap matrix, which must outlive the solver **/
+        explicit Cgls(const BlockSparseMatrix & matrix);
+        /** Solve with compressed overlap stencils, which must outlive the solver **/
+        explicit Cgls(const StencilMatrix & matrix);
+        /** Solve matrix-free, the operator must outlive the solver **/
+        explicit Cgls(const DrizzleOperator & drizzle);
+
+        Cgls & set_weights(const RealVector & weights);
+        Cgls & set_damping(real damping);
+        Cgls & set_tolerance(real tolerance);
+        Cgls & set_max_iterations(int max_iterations);
+        Cgls & set_verbose(bool verbose);
+        /** Precondition by the inverse of the coverage map, computed in `solve` from the weights and damping
+         *  in effect at that time, so the setters may be called in any order **/
+        Cgls & set_jacobi_preconditioner(bool jacobi = true);
+
+        /** Solve for the observations b, starting from zero or from the initial guess x0 **/
+        [[nodiscard]] RealVector solve(const RealVector & observations);
+        [[nodiscard]] RealVector solve(const RealVector & observations, const RealVector & initial);
+
+        [[nodiscard]] const std::vector<CglsIteration> & history() const { return this->history_; }
+        [[nodiscard]] bool converged() const { return this->converged_; }
+        [[nodiscard]] int iterations() const { return static_cast<int>(this->history_.size()); }
+    };
+}
+
+#endif //ANASTASIS_CPP_CGLS_H
@@ -0,0 +1,202 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+#include <unistd.h>
+
+#include <Eigen/SparseCholesky>
+
+#include "choleskyfactor.h"
+#include "utils/mappedfile.h"
+#include "utils/parallel.h"
+
+namespace Astar {
+    namespace {
+        constexpr char Magic[8] = {'A', 'N', 'A', 'L', 'D', 'L', '0', '1'};
+
+        struct FileHeader {
+            char magic[8];
+            std::uint32_t scalar_size;
+            std::uint32_t reserved;
+            std::int64_t size;
+            std::int64_t nonzeros;
+            char padding[32];
+        };
+        static_assert(sizeof(FileHeader) == 64, "Factor file header must be exactly 64 bytes");
+
+        /** Byte offsets of the arrays that follow the header **/
+        struct Layout {
+            std::size_t permutation;
+            std::size_t outer;
+            std::size_t inner;
+            std::size_t diagonal;
+            std::size_t values;
+            std::size_t end;
+
+            Layout(std::int64_t size, std::int64_t nonzeros):
+                permutation(sizeof(FileHeader)),
+                outer(permutation + size * sizeof(int)),
+                inner(outer + (size + 1) * sizeof(int)),
+                diagonal((inner + nonzeros * sizeof(int) + 7) / 8 * 8),
+                values(diagonal + size * sizeof(real)),
+                end(values + nonzeros * sizeof(real))
+            {}
+        };
+    }
+
+    CholeskyFactor::CholeskyFactor(RealSparseMatrix lower, RealVector diagonal, Permutation permutation, int threads):
+        lower_(std::move(lower)),
+        diagonal_(std::move(diagonal)),
+        permutation_(std::move(permutation)),
+        threads_(threads)
+    {}
+
+    CholeskyFactor::CholeskyFactor(const RealSparseMatrix & normal, real damping, int threads):
+        threads_(threads)
+    {
+        if (normal.rows() != normal.cols()) {
+            throw std::invalid_argument(fmt::format("Normal matrix must be square, got {}×{}", normal.rows(), normal.cols()));
+        }
+
+        RealSparseMatrix identity(normal.rows(), normal.cols());
+        identity.setIdentity();
+        Eigen::SimplicialLDLT<RealSparseMatrix, Eigen::Lower, Eigen::AMDOrdering<int>> ldlt(normal + damping * identity);
+        if (ldlt.info() != Eigen::Success) {
+            throw std::runtime_error("Sparse LDL^T factorisation failed, the normal matrix is singular: increase the damping");
+        }
+
+        // Keep just the factor itself, the solver does not expose a way to be restored from it
+        this->lower_ = ldlt.matrixL().nestedExpression();
+        this->lower_.makeCompressed();
+        this->diagonal_ = ldlt.vectorD();
+        this->permutation_ = ldlt.permutationP();
+        if ((this->diagonal_.array() <= 0).any()) {
+            throw std::runtime_error("Normal matrix is not positive definite: increase the damping");
+        }
+    }
+
+    CholeskyFactor::CholeskyFactor(const NormalEquations & equations, real damping, int threads):
+        CholeskyFactor(equations.matrix(), damping, threads)
+    {}
+
+    RealVector CholeskyFactor::solve(const RealVector & rhs) const {
+        if (rhs.size() != this->size()) {
+            throw std::invalid_argument(fmt::format("Right-hand side has {} entries, expected {}", rhs.size(), this->size()));
+        }
+
+        RealVector x = this->permutation_ * rhs;
+        this->lower_.triangularView<Eigen::UnitLower>().solveInPlace(x);
+        x.array() /= this->diagonal_.array();
+        this->lower_.transpose().triangularView<Eigen::UnitUpper>().solveInPlace(x);
+        return this->permutation_.transpose() * x;
+    }
+
+    RealMatrix CholeskyFactor::solve(const RealMatrix & rhs) const {
+        if (rhs.rows() != this->size()) {
+            throw std::invalid_argument(fmt::format("Right-hand sides have {} rows, expected {}", rhs.rows(), this->size()));
+        }
+
+        // Every thread solves a block of columns, kept column-major so that each frame is contiguous
+        RealMatrix out(rhs.rows(), rhs.cols());
+        parallel_for(0, static_cast<int>(rhs.cols()), this->threads_, [&](int, int begin, int end) {
+            Eigen::MatrixXd x = this->permutation_ * rhs.middleCols(begin, end - begin);
+            this->lower_.triangularView<Eigen::UnitLower>().solveInPlace(x);
+            x = this->diagonal_.cwiseInverse().asDiagonal() * x;
+            this->lower_.transpose().triangularView<Eigen::UnitUpper>().solveInPlace(x);
+            out.middleCols(begin, end - begin) = this->permutation_.transpose() * x;
+        });
+        return out;
+    }
+
+    void CholeskyFactor::save(const std::string & filename) const {
+        FileHeader header {};
+        std::memcpy(header.magic, Magic, sizeof Magic);
+        header.scalar_size = sizeof(real);
+        header.size = this->size();
+        header.nonzeros = this->nonZeros();
+        const Layout layout(header.size, header.nonzeros);
+
+        // Write to a temporary file first, so that a crash never leaves a partial factor under the final name
+        const std::string temporary = fmt::format("{}.{}.tmp", filename, ::getpid());
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            if (!out) {
+                throw std::runtime_error(fmt::format("Could not write factor file {}", temporary));
+            }
+            const char zeros[8] = {};
+            out.write(reinterpret_cast<const char *>(&header), sizeof header);
+            out.write(reinterpret_cast<const char *>(this->permutation_.indices().data()), header.size * sizeof(int));
+            out.write(reinterpret_cast<const char *>(this->lower_.outerIndexPtr()), (header.size + 1) * sizeof(int));
+            out.write(reinterpret_cast<const char *>(this->lower_.innerIndexPtr()), header.nonzeros * sizeof(int));
+            out.write(zeros, static_cast<std::streamsize>(layout.diagonal - layout.inner - header.nonzeros * sizeof(int)));
+            out.write(reinterpret_cast<const char *>(this->diagonal_.data()), header.size * sizeof(real));
+            out.write(reinterpret_cast<const char *>(this->lower_.valuePtr()), header.nonzeros * sizeof(real));
+            if (!out) {
+                throw std::runtime_error(fmt::format("Could not write factor file {}", temporary));
+            }
+        }
+        std::filesystem::rename(temporary, filename);
+    }
+
+    CholeskyFactor CholeskyFactor::load(const std::string & filename, int threads) {
+        const MappedFile file(filename);
+        const FileHeader & header = *file.view<FileHeader>(0);
+        if ((std::memcmp(header.magic, Magic, sizeof Magic) != 0) || (header.scalar_size != sizeof(real))) {
+            throw std::runtime_error(fmt::format("{} is not a valid factor file", filename));
+        }
+        if ((header.size < 0) || (header.nonzeros < 0) || (header.size >= std::numeric_limits<int>::max()) ||
+            (header.nonzeros > std::numeric_limits<int>::max())) {
+            throw std::runtime_error(fmt::format("Factor file {} has an inconsistent header", filename));
+        }
+
+        // Views are bounds-checked, so a truncated file throws here
+        const Layout layout(header.size, header.nonzeros);
+        const int * permutation = file.view<int>(layout.permutation, header.size);
+        const int * outer = file.view<int>(layout.outer, header.size + 1);
+        const int * inner = file.view<int>(layout.inner, header.nonzeros);
+        const real * diagonal = file.view<real>(layout.diagonal, header.size);
+        const real * values = file.view<real>(layout.values, header.nonzeros);
+
+        // Everything else comes from outside too and the triangular solves index with it unchecked:
+        // the permutation must be one, L strictly lower triangular by columns and D finite and nonzero
+        std::vector<bool> seen(header.size, false);
+        for (std::int64_t cell = 0; cell < header.size; ++cell) {
+            if ((permutation[cell] < 0) || (permutation[cell] >= header.size) || seen[permutation[cell]]) {
+                throw std::runtime_error(fmt::format("Factor file {} has an invalid permutation at {}", filename, cell));
+            }
+            seen[permutation[cell]] = true;
+        }
+        if ((outer[0] != 0) || (outer[header.size] != header.nonzeros)) {
+            throw std::runtime_error(fmt::format("Outer indices in factor file {} do not span the nonzeros", filename));
+        }
+        for (std::int64_t column = 0; column < header.size; ++column) {
+            if (outer[column + 1] < outer[column]) {
+                throw std::runtime_error(fmt::format("Outer indices in factor file {} decrease at column {}", filename, column));
+            }
+            for (int k = outer[column]; k < outer[column + 1]; ++k) {
+                if ((inner[k] <= column) || (inner[k] >= header.size) || ((k > outer[column]) && (inner[k] <= inner[k - 1]))) {
+                    throw std::runtime_error(fmt::format("Factor file {} has an invalid row index {} in column {}",
+                                                         filename, inner[k], column));
+                }
+            }
+            if (!std::isfinite(diagonal[column]) || (diagonal[column] == 0)) {
+                throw std::runtime_error(fmt::format("Factor file {} has an invalid diagonal entry {} at {}",
+                                                     filename, diagonal[column], column));
+            }
+        }
+
+        RealSparseMatrix lower(header.size, header.size);
+        lower.resizeNonZeros(header.nonzeros);
+        std::copy_n(outer, header.size + 1, lower.outerIndexPtr());
+        std::copy_n(inner, header.nonzeros, lower.innerIndexPtr());
+        std::copy_n(values, header.nonzeros, lower.valuePtr());
+
+        Permutation order(header.size);
+        std::copy_n(permutation, header.size, order.indices().data());
+        return CholeskyFactor(std::move(lower), RealVector(Eigen::Map<const RealVector>(diagonal, header.size)),
+                              std::move(order), threads);
+    }
+}
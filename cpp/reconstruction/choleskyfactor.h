@@ -0,0 +1,51 @@
+#ifndef ANASTASIS_CPP_CHOLESKYFACTOR_H
+#define ANASTASIS_CPP_CHOLESKYFACTOR_H
+
+#include <string>
+
+#include "utils/eigen.h"
+#include "reconstruction/normalequations.h"
+
+namespace Astar {
+    /** Sparse LDL^T factorisation P (A^T W A + damping I) P^T = L D L^T of the normal equations,
+     *  for reconstructing many frames taken with the same pointing pattern: the matrix depends only on the geometry,
+     *  so it is factorised once and every frame then costs just a permutation and two triangular solves.
+     *
+     *  The factor can be saved to a file and loaded back, which skips the factorisation altogether:
+     *
+     *      header (64 bytes): magic "ANALDL01", scalar size, number of cells, nonzeros of L
+     *      permutation (cells × int32), outer indices (cells + 1 × int32), inner indices (nonzeros × int32),
+     *      padding to 8 bytes, D (cells × double), values of L (nonzeros × double)
+     *
+     *  Files are written under a temporary name and renamed, and every index is validated on loading.
+     *  Cells not covered by any exposure make the matrix singular, in that case some damping is required.
+     *  `subpixel --frames` reconstructs a series of frames this way.
+     */
+    class CholeskyFactor {
+    public:
+        typedef Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> Permutation;
+    private:
+        RealSparseMatrix lower_;        // Strictly lower part of the unit lower triangular L, by columns
+        RealVector diagonal_;
+        Permutation permutation_;
+        int threads_;
+
+        CholeskyFactor(RealSparseMatrix lower, RealVector diagonal, Permutation permutation, int threads);
+    public:
+        explicit CholeskyFactor(const RealSparseMatrix & normal, real damping = 0, int threads = 1);
+        explicit CholeskyFactor(const NormalEquations & equations, real damping = 0, int threads = 1);
+
+        [[nodiscard]] Eigen::Index size() const { return this->diagonal_.size(); }
+        [[nodiscard]] Eigen::Index nonZeros() const { return this->lower_.nonZeros(); }
+
+        /** Solve for a single right-hand side A^T W b **/
+        [[nodiscard]] RealVector solve(const RealVector & rhs) const;
+        /** Solve for many frames at once, one right-hand side per column, split between the threads **/
+        [[nodiscard]] RealMatrix solve(const RealMatrix & rhs) const;
+
+        void save(const std::string & filename) const;
+        [[nodiscard]] static CholeskyFactor load(const std::string & filename, int threads = 1);
+    };
+}
+
+#endif //ANASTASIS_CPP_CHOLESKYFACTOR_H
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <complex>
+#include <set>
+
+#include <unsupported/Eigen/FFT>
+
+#include "interlacing.h"
+
+namespace Astar {
+    namespace {
+        typedef Eigen::Matrix<std::complex<real>, Eigen::Dynamic, Eigen::Dynamic> Spectrum;
+
+        /** Split offsets (in pixels) into N regular sub-pixel positions, returning N and the position of each
+         *  relative to the lowest one, or nothing if they are not multiples of 1/N forming N consecutive positions
+         */
+        std::optional<std::pair<int, std::vector<int>>> regular_offsets(const std::vector<real> & offsets, real tolerance) {
+            std::vector<real> sorted = offsets;
+            std::sort(sorted.begin(), sorted.end());
+            int count = 1;
+            for (std::size_t i = 1; i < sorted.size(); ++i) {
+                if (sorted[i] - sorted[i - 1] > tolerance) {
+                    ++count;
+                }
+            }
+
+            std::vector<int> positions;
+            std::set<int> distinct;
+            for (real offset: offsets) {
+                const real scaled = offset * count;
+                const int position = static_cast<int>(std::lround(scaled));
+                if (std::abs(scaled - position) > tolerance * count) {
+                    return std::nullopt;
+                }
+                positions.push_back(position);
+                distinct.insert(position);
+            }
+            if ((static_cast<int>(distinct.size()) != count) || (*distinct.rbegin() - *distinct.begin() != count - 1)) {
+                return std::nullopt;
+            }
+
+            const int lowest = *distinct.begin();
+            for (int & position: positions) {
+                position -= lowest;
+            }
+            return std::make_pair(count, positions);
+        }
+
+        /** Spectrum of a box of `width` fine pixels with unit sum, centred on pixel 0 of a periodic signal **/
+        std::vector<std::complex<real>> box_spectrum(real width, int length) {
+            std::vector<real> kernel(length, 0.0);
+            const int reach = static_cast<int>(std::ceil(width / 2 + 0.5));
+            for (int d = -reach; d <= reach; ++d) {
+                const real overlap = std::min(d + 0.5, width / 2) - std::max(d - 0.5, -width / 2);
+                if (overlap > 0) {
+                    kernel[((d % length) + length) % length] += overlap / width;
+                }
+            }
+
+            Eigen::FFT<real> fft;
+            std::vector<std::complex<real>> spectrum;
+            fft.fwd(spectrum, kernel);
+            return spectrum;
+        }
+
+        /** Two-dimensional transform as rows followed by columns **/
+        void transform(Spectrum & data, bool inverse) {
+            Eigen::FFT<real> fft;
+            std::vector<std::complex<real>> in;
+            std::vector<std::complex<real>> out;
+            for (Eigen::Index row = 0; row < data.rows(); ++row) {
+                in.assign(data.cols(), 0);
+                for (Eigen::Index col = 0; col < data.cols(); ++col) {
+                    in[col] = data(row, col);
+                }
+                inverse ? fft.inv(out, in) : fft.fwd(out, in);
+                for (Eigen::Index col = 0; col < data.cols(); ++col) {
+                    data(row, col) = out[col];
+                }
+            }
+            for (Eigen::Index col = 0; col < data.cols(); ++col) {
+                in.assign(data.col(col).begin(), data.col(col).end());
+                inverse ? fft.inv(out, in) : fft.fwd(out, in);
+                std::copy(out.begin(), out.end(), data.col(col).begin());
+            }
+        }
+    }
+
+    FourierInterlacing::FourierInterlacing(pair<int> factor, std::vector<pair<int>> positions, Point centre,
+                                           pair<real> physical_size, pair<int> grid_size, pair<real> response):
+        factor_(factor),
+        positions_(std::move(positions)),
+        centre_(centre),
+        physical_size_(physical_size),
+        grid_size_(grid_size),
+        response_(response)
+    {}
+
+    std::optional<FourierInterlacing> FourierInterlacing::detect(const std::vector<DetectorImage> & exposures,
+                                                                 real tolerance) {
+        if (exposures.size() < 2) {
+            return std::nullopt;
+        }
+
+        const DetectorImage & reference = exposures.front();
+        const real pitch_x = reference.physical_size().first / reference.width();
+        const real pitch_y = reference.physical_size().second / reference.height();
+        std::vector<real> offsets_x;
+        std::vector<real> offsets_y;
+        for (auto && image: exposures) {
+            if ((image.size() != reference.size()) || (std::abs(image.rotation()) > tolerance) ||
+                (std::abs(image.physical_size().first - reference.physical_size().first) > tolerance * pitch_x) ||
+                (std::abs(image.physical_size().second - reference.physical_size().second) > tolerance * pitch_y) ||
+                (std::abs(image.pixfrac().first - reference.pixfrac().first) > tolerance) ||
+                (std::abs(image.pixfrac().second - reference.pixfrac().second) > tolerance)) {
+                return std::nullopt;
+            }
+            offsets_x.push_back((image.centre().x - reference.centre().x) / pitch_x);
+            offsets_y.push_back((image.centre().y - reference.centre().y) / pitch_y);
+        }
+
+        const auto horizontal = regular_offsets(offsets_x, tolerance);
+        const auto vertical = regular_offsets(offsets_y, tolerance);
+        if (!horizontal || !vertical ||
+            (static_cast<std::size_t>(horizontal->first) * vertical->first != exposures.size())) {
+            return std::nullopt;
+        }
+
+        // Every combination of the horizontal and vertical positions must be taken exactly once
+        std::vector<pair<int>> positions;
+        for (std::size_t e = 0; e < exposures.size(); ++e) {
+            positions.emplace_back(horizontal->second[e], vertical->second[e]);
+        }
+        if (std::set<pair<int>>(positions.begin(), positions.end()).size() != exposures.size()) {
+            return std::nullopt;
+        }
+
+        // The lowest exposure is offset from the reference by -(position of the reference) / N pixels.
+        // The centre of its first pixel is the centre of fine pixel 0, 0.5 / N pixels from the corner of the fine grid,
+        // so the fine grid is shifted by (1 - 1 / N) / 2 pixels against the lowest exposure
+        const pair<int> factor = {horizontal->first, vertical->first};
+        const Point centre = {
+            reference.centre().x + pitch_x * (0.5 - 0.5 / factor.first - static_cast<real>(positions.front().first) / factor.first),
+            reference.centre().y + pitch_y * (0.5 - 0.5 / factor.second - static_cast<real>(positions.front().second) / factor.second),
+        };
+        // Measure the footprint rather than recomputing it from pixfrac, so that it is exactly what the overlaps use
+        const Pixel pixel = reference.world_pixel(0, 0);
+        const pair<real> response = {(pixel.b().x - pixel.a().x) / pitch_x, (pixel.d().y - pixel.a().y) / pitch_y};
+        return FourierInterlacing(factor, std::move(positions), centre, reference.physical_size(),
+                                  reference.size(), response);
+    }
+
+    DetectorImage FourierInterlacing::interlace(const std::vector<DetectorImage> & exposures) const {
+        if (exposures.size() != this->positions_.size()) {
+            throw std::invalid_argument(fmt::format("Dither pattern has {} exposures, got {}",
+                                                    this->positions_.size(), exposures.size()));
+        }
+
+        const auto [n, m] = this->factor_;
+        Matrix fine(this->grid_size_.second * m, this->grid_size_.first * n);
+        for (std::size_t e = 0; e < exposures.size(); ++e) {
+            const auto [dx, dy] = this->positions_[e];
+            const Matrix & data = exposures[e].data();
+            for (int row = 0; row < data.rows(); ++row) {
+                for (int col = 0; col < data.cols(); ++col) {
+                    fine(m * row + dy, n * col + dx) = data(row, col);
+                }
+            }
+        }
+        return DetectorImage(this->centre_, this->physical_size_, 0, {1, 1}, fine);
+    }
+
+    DetectorImage FourierInterlacing::deconvolve(const std::vector<DetectorImage> & exposures, real regularisation) const {
+        DetectorImage fine = this->interlace(exposures);
+        const auto [n, m] = this->factor_;
+
+        Spectrum spectrum = fine.data().cast<std::complex<real>>();
+        transform(spectrum, false);
+
+        // Wiener filter with the separable response of a pixel footprint, in fine pixels
+        const auto response_x = box_spectrum(n * this->response_.first, static_cast<int>(spectrum.cols()));
+        const auto response_y = box_spectrum(m * this->response_.second, static_cast<int>(spectrum.rows()));
+        for (Eigen::Index row = 0; row < spectrum.rows(); ++row) {
+            for (Eigen::Index col = 0; col < spectrum.cols(); ++col) {
+                const std::complex<real> response = response_x[col] * response_y[row];
+                spectrum(row, col) *= std::conj(response) / (std::norm(response) + regularisation);
+            }
+        }
+
+        transform(spectrum, true);
+        fine.data() = spectrum.real().cast<storage>();
+        return fine;
+    }
+
+    ModelImage FourierInterlacing::reconstruct(const std::vector<DetectorImage> & exposures, pair<int> model_size,
+                                               real regularisation) const {
+        // naive_drizzle divides by the pixel area, so scale by it to get the mean value over every unit cell
+        DetectorImage fine = this->deconvolve(exposures, regularisation);
+        fine *= fine.pixel_area(0, 0);
+
+        ModelImage model(model_size);
+        model.naive_drizzle(fine);
+        return model;
+    }
+}
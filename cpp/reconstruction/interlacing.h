@@ -0,0 +1,50 @@
+#ifndef ANASTASIS_CPP_INTERLACING_H
+#define ANASTASIS_CPP_INTERLACING_H
+
+#include <optional>
+#include <vector>
+
+#include "utils/eigen.h"
+#include "grid/detectorimage.h"
+#include "grid/modelimage.h"
+
+namespace Astar {
+    /** Reconstruction of a regular N×M sub-pixel dither by Fourier interlacing (Lauer 1999), without any solve.
+     *
+     *  If all exposures share the grid, pixel size and pixfrac, are not rotated, and their shifts are exactly
+     *  the multiples of 1/N of a pixel horizontally and 1/M vertically, every combination once, then their pixels
+     *  interleave into a single fine image with N×M times as many pixels. Its values are the fine image convolved
+     *  with the pixel response, a box as wide as the footprint of a detector pixel, which is then removed
+     *  by Wiener deconvolution in frequency space. The fine image is treated as periodic, so expect some ringing
+     *  near its edges.
+     */
+    class FourierInterlacing {
+    private:
+        pair<int> factor_;
+        std::vector<pair<int>> positions_;  // Offset of every exposure on the fine grid, relative to the lowest one
+        Point centre_;                      // Centre of the fine grid
+        pair<real> physical_size_;
+        pair<int> grid_size_;               // Grid size of a single exposure
+        pair<real> response_;               // Width of a pixel footprint as a fraction of the pixel pitch
+
+        FourierInterlacing(pair<int> factor, std::vector<pair<int>> positions, Point centre,
+                           pair<real> physical_size, pair<int> grid_size, pair<real> response);
+    public:
+        /** Recognise a regular dither, offsets must be multiples of 1/N pixels up to `tolerance` pixels **/
+        [[nodiscard]] static std::optional<FourierInterlacing> detect(const std::vector<DetectorImage> & exposures,
+                                                                      real tolerance = 1e-6);
+
+        [[nodiscard]] pair<int> factor() const { return this->factor_; }
+
+        /** Exposures interleaved into a single fine image, still convolved with the pixel response **/
+        [[nodiscard]] DetectorImage interlace(const std::vector<DetectorImage> & exposures) const;
+        /** Fine image with the pixel response deconvolved, `regularisation` is the Wiener noise-to-signal ratio **/
+        [[nodiscard]] DetectorImage deconvolve(const std::vector<DetectorImage> & exposures,
+                                               real regularisation = 1e-3) const;
+        /** Deconvolved fine image resampled to the mean values of the model cells **/
+        [[nodiscard]] ModelImage reconstruct(const std::vector<DetectorImage> & exposures, pair<int> model_size,
+                                             real regularisation = 1e-3) const;
+    };
+}
+
+#endif //ANASTASIS_CPP_INTERLACING_H
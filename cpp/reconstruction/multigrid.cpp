@@ -0,0 +1,102 @@
+#include "multigrid.h"
+#include "grid/drizzleoperator.h"
+#include "reconstruction/cgls.h"
+
+namespace Astar {
+    CascadicMultigrid::CascadicMultigrid(pair<int> model_size, const std::vector<DetectorImage> & exposures,
+                                         int levels, int threads):
+        AbstractGrid(model_size),
+        exposures_(exposures),
+        levels_(levels),
+        threads_(threads)
+    {
+        if (levels < 1) {
+            throw std::invalid_argument(fmt::format("Multigrid needs at least one level, got {}", levels));
+        }
+    }
+
+    CascadicMultigrid & CascadicMultigrid::set_damping(real damping) {
+        this->damping_ = damping;
+        return *this;
+    }
+
+    CascadicMultigrid & CascadicMultigrid::set_tolerance(real tolerance) {
+        this->tolerance_ = tolerance;
+        return *this;
+    }
+
+    CascadicMultigrid & CascadicMultigrid::set_max_iterations(int max_iterations) {
+        this->max_iterations_ = max_iterations;
+        return *this;
+    }
+
+    CascadicMultigrid & CascadicMultigrid::set_verbose(bool verbose) {
+        this->verbose_ = verbose;
+        return *this;
+    }
+
+    pair<int> CascadicMultigrid::level_size(int level) const {
+        // Round up, so that the coarse model covers the whole fine one
+        const int factor = 1 << level;
+        return {(this->width() + factor - 1) / factor, (this->height() + factor - 1) / factor};
+    }
+
+    int CascadicMultigrid::iterations() const {
+        int iterations = 0;
+        for (auto && level: this->history_) {
+            iterations += level.iterations;
+        }
+        return iterations;
+    }
+
+    ModelImage CascadicMultigrid::solve() {
+        this->history_.clear();
+        ModelImage model(this->level_size(this->levels_ - 1));
+
+        for (int level = this->levels_ - 1; level >= 0; --level) {
+            const pair<int> size = this->level_size(level);
+
+            // Prolongate the coarser solution: every coarse cell becomes a 2×2 block of fine cells.
+            // Drizzling divides by the pixel area, so scale by it to copy the mean values.
+            RealVector initial = RealVector::Zero(static_cast<Eigen::Index>(size.first) * size.second);
+            if (level < this->levels_ - 1) {
+                const DetectorImage coarse(
+                    Point(model.width(), model.height()), pair<real>(2 * model.width(), 2 * model.height()),
+                    0, {1, 1}, Matrix(model.data() * 4)
+                );
+                model = ModelImage(size);
+                model.naive_drizzle(coarse);
+                initial = model.data().reshaped<Eigen::RowMajor>().cast<real>();
+            }
+
+            // The finest level uses the exposures as they are, coarser ones the same data in a scaled world
+            const DrizzleOperator drizzle = (level > 0) ?
+                DrizzleOperator::scaled(size, this->exposures_, 1.0 / static_cast<real>(1 << level), this->threads_) :
+                DrizzleOperator(size, this->exposures_, this->threads_);
+            RealVector observations = drizzle.observations();
+            for (std::size_t e = 0; e < this->exposures_.size(); ++e) {
+                const DetectorGeometry & geometry = drizzle.geometry(e);
+                observations.segment(drizzle.offset(e), geometry.count()) *= geometry.pixel_area(0, 0);
+            }
+
+            // CGLS measures the residual relative to its starting point, convert to the residual of the zero model
+            const real reference = drizzle.adjoint(observations).norm();
+            const real start = (drizzle.adjoint(observations - drizzle.forward(initial)) - this->damping_ * initial).norm();
+
+            Cgls solver(drizzle);
+            solver.set_damping(this->damping_).set_jacobi_preconditioner().set_max_iterations(this->max_iterations_);
+            if ((start > 0) && (reference > 0)) {
+                solver.set_tolerance(this->tolerance_ * reference / start);
+            }
+            const RealVector solution = solver.solve(observations, initial);
+            model = drizzle.as_image(solution);
+
+            this->history_.push_back({size, solver.iterations(), solver.converged()});
+            if (this->verbose_) {
+                fmt::print("Multigrid level {} ({}×{}): {} after {} iterations\n", level, size.first, size.second,
+                           solver.converged() ? "converged" : "stopped", solver.iterations());
+            }
+        }
+        return model;
+    }
+}
@@ -0,0 +1,253 @@
+#include <cmath>
+
+#include "normalequations.h"
+#include "utils/parallel.h"
+
+namespace Astar {
+    NormalEquations::NormalEquations(pair<int> model_size, int radius, int threads):
+        AbstractGrid(model_size),
+        radius_(radius),
+        stride_(radius + 1 + radius * (2 * radius + 1)),
+        threads_(threads),
+        coefficients_(static_cast<std::size_t>(this->count()) * this->stride_, 0.0),
+        rhs_(RealVector::Zero(this->count()))
+    {
+        if (radius < 0) {
+            throw std::invalid_argument(fmt::format("Coupling radius must not be negative, got {}", radius));
+        }
+    }
+
+    int NormalEquations::coupling_radius(const DetectorImage & image) {
+        /** All world pixels are translates of one another, so the first one has the extent of every one of them.
+         *  An interval of length w not aligned with the cells covers ceil(w) + 1 of them, ceil(w) apart. **/
+        const Pixel pixel = image.world_pixel(0, 0);
+        real left = pixel.a().x;
+        real right = pixel.a().x;
+        real bottom = pixel.a().y;
+        real top = pixel.a().y;
+        for (const Point corner: {pixel.b(), pixel.c(), pixel.d()}) {
+            left = std::min(left, corner.x);
+            right = std::max(right, corner.x);
+            bottom = std::min(bottom, corner.y);
+            top = std::max(top, corner.y);
+        }
+        return static_cast<int>(std::ceil(std::max(right - left, top - bottom)));
+    }
+
+    int NormalEquations::coupling_radius(const std::vector<DetectorImage> & images) {
+        int radius = 0;
+        for (auto && image: images) {
+            radius = std::max(radius, NormalEquations::coupling_radius(image));
+        }
+        return radius;
+    }
+
+    int NormalEquations::slot(int dx, int dy) const {
+        /** Index of the coefficient coupling a cell to its neighbour at (dx, dy), which follows it in row-major order **/
+        return (dy == 0) ? dx : this->radius_ + 1 + (dy - 1) * (2 * this->radius_ + 1) + dx + this->radius_;
+    }
+
+    NormalEquations & NormalEquations::add(const DetectorImage & image) {
+        this->accumulate(image, nullptr);
+        return *this;
+    }
+
+    NormalEquations & NormalEquations::add(const DetectorImage & image, const Matrix & weights) {
+        if ((weights.rows() != image.height()) || (weights.cols() != image.width())) {
+            throw std::invalid_argument(fmt::format("Weights are {}×{}, but the image is {}×{}",
+                                                    weights.cols(), weights.rows(), image.width(), image.height()));
+        }
+        this->accumulate(image, weights.data());
+        return *this;
+    }
+
+    void NormalEquations::accumulate(const DetectorImage & image, const storage * weights) {
+        const SparseMatrix overlaps = ModelImage::overlap_matrix(this->size(), image, this->threads_);
+        const int * const outer = overlaps.outerIndexPtr();
+        const int * const inner = overlaps.innerIndexPtr();
+        const storage * const values = overlaps.valuePtr();
+        const storage * const observed = image.data().data();
+        const int width = this->width();
+        const real area = image.pixel_area(0, 0);
+
+        // Bucket the detector pixels by the lowest model row they overlap, checking that every footprint
+        // fits within the radius before anything is added, so that a rejected exposure leaves no trace
+        std::vector<int> first(this->height() + 1, 0);
+        for (int pixel = 0; pixel < overlaps.rows(); ++pixel) {
+            if (outer[pixel] == outer[pixel + 1]) {
+                continue;
+            }
+            int left = width;
+            int right = 0;
+            for (int k = outer[pixel]; k < outer[pixel + 1]; ++k) {
+                left = std::min(left, inner[k] % width);
+                right = std::max(right, inner[k] % width);
+            }
+            const int bottom = inner[outer[pixel]] / width;
+            const int top = inner[outer[pixel + 1] - 1] / width;
+            if ((right - left > this->radius_) || (top - bottom > this->radius_)) {
+                throw std::invalid_argument(fmt::format(
+                    "Pixel {} overlaps {}×{} model cells, more than the coupling radius {} allows",
+                    pixel, right - left + 1, top - bottom + 1, this->radius_
+                ));
+            }
+            ++first[bottom + 1];
+        }
+        for (int y = 0; y < this->height(); ++y) {
+            first[y + 1] += first[y];
+        }
+        std::vector<int> order(first.back());
+        {
+            std::vector<int> next(first.begin(), first.end() - 1);
+            for (int pixel = 0; pixel < overlaps.rows(); ++pixel) {
+                if (outer[pixel] < outer[pixel + 1]) {
+                    order[next[inner[outer[pixel]] / width]++] = pixel;
+                }
+            }
+        }
+
+        // Every thread owns the model rows [begin, end) and adds the contributions of all pairs of cells
+        // whose first cell lies there. Only pixels starting at most `radius` rows below can contribute.
+        parallel_for(0, this->height(), this->threads_, [&](int, int begin, int end) {
+            for (int k = first[std::max(0, begin - this->radius_)]; k < first[end]; ++k) {
+                const int pixel = order[k];
+                const real weight = (weights == nullptr) ? 1.0 : static_cast<real>(weights[pixel]);
+                if (weight == 0) {
+                    continue;
+                }
+                const real value = weight * area * static_cast<real>(observed[pixel]);
+                for (int a = outer[pixel]; a < outer[pixel + 1]; ++a) {
+                    const int cell = inner[a];
+                    const int y = cell / width;
+                    if ((y < begin) || (y >= end)) {
+                        continue;
+                    }
+                    const real wa = weight * static_cast<real>(values[a]);
+                    this->rhs_[cell] += static_cast<real>(values[a]) * value;
+
+                    real * const row = this->coefficients_.data() + static_cast<std::size_t>(cell) * this->stride_;
+                    const int x = cell % width;
+                    // Columns are sorted, so all later entries follow this cell in row-major order
+                    for (int b = a; b < outer[pixel + 1]; ++b) {
+                        const int other = inner[b];
+                        row[this->slot(other % width - x, other / width - y)] += wa * static_cast<real>(values[b]);
+                    }
+                }
+            }
+        });
+        ++this->exposures_;
+    }
+
+    RealVector NormalEquations::diagonal() const {
+        RealVector diagonal(this->count());
+        for (int cell = 0; cell < this->count(); ++cell) {
+            diagonal[cell] = this->coefficients_[static_cast<std::size_t>(cell) * this->stride_];
+        }
+        return diagonal;
+    }
+
+    RealVector NormalEquations::multiply(const RealVector & x) const {
+        if (x.size() != this->count()) {
+            throw std::invalid_argument(fmt::format("Model vector has {} entries, expected {}", x.size(), this->count()));
+        }
+
+        // Gather both triangles for every cell: its own stored coefficients, and those of the preceding cells
+        // coupled to it, so that rows can be processed in parallel
+        RealVector out(this->count());
+        const int r = this->radius_;
+        parallel_for(0, this->height(), this->threads_, [&](int, int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                for (int cx = 0; cx < this->width(); ++cx) {
+                    const int cell = this->width() * y + cx;
+                    const real * const own = this->coefficients_.data() + static_cast<std::size_t>(cell) * this->stride_;
+                    real sum = own[0] * x[cell];
+                    for (int dy = 0; dy <= r; ++dy) {
+                        for (int dx = (dy == 0) ? 1 : -r; dx <= r; ++dx) {
+                            // Upper triangle: (cell, cell + d), lower triangle: (cell - d, cell)
+                            if ((y + dy < this->height()) && (cx + dx >= 0) && (cx + dx < this->width())) {
+                                sum += own[this->slot(dx, dy)] * x[cell + this->width() * dy + dx];
+                            }
+                            if ((y - dy >= 0) && (cx - dx >= 0) && (cx - dx < this->width())) {
+                                const int before = cell - this->width() * dy - dx;
+                                sum += this->coefficients_[static_cast<std::size_t>(before) * this->stride_ + this->slot(dx, dy)] * x[before];
+                            }
+                        }
+                    }
+                    out[cell] = sum;
+                }
+            }
+        });
+        return out;
+    }
+
+    RealSparseMatrix NormalEquations::matrix() const {
+        std::vector<Eigen::Triplet<real>> triplets;
+        const int r = this->radius_;
+        for (int y = 0; y < this->height(); ++y) {
+            for (int x = 0; x < this->width(); ++x) {
+                const int cell = this->width() * y + x;
+                const real * const own = this->coefficients_.data() + static_cast<std::size_t>(cell) * this->stride_;
+                for (int dy = 0; dy <= r; ++dy) {
+                    for (int dx = (dy == 0) ? 0 : -r; dx <= r; ++dx) {
+                        const real value = own[this->slot(dx, dy)];
+                        if ((value == 0) || (y + dy >= this->height()) || (x + dx < 0) || (x + dx >= this->width())) {
+                            continue;
+                        }
+                        const int other = cell + this->width() * dy + dx;
+                        triplets.emplace_back(cell, other, value);
+                        if (other != cell) {
+                            triplets.emplace_back(other, cell, value);
+                        }
+                    }
+                }
+            }
+        }
+
+        RealSparseMatrix matrix(this->count(), this->count());
+        matrix.setFromTriplets(triplets.begin(), triplets.end());
+        return matrix;
+    }
+
+    RealVector NormalEquations::solve(real damping, real tolerance, int max_iterations, bool verbose) const {
+        // Cells not covered by any pixel have a zero row, leave them unscaled (and zero)
+        const RealVector preconditioner = this->diagonal().unaryExpr([damping](real d) {
+            return (d + damping > 0) ? 1.0 / (d + damping) : 1.0;
+        });
+
+        RealVector x = RealVector::Zero(this->count());
+        RealVector s = this->rhs_;
+        RealVector z = preconditioner.cwiseProduct(s);
+        RealVector p = z;
+        real gamma = s.dot(z);
+        const real initial_norm = s.norm();
+        if (initial_norm == 0) {
+            return x;
+        }
+
+        for (int iteration = 1; iteration <= max_iterations; ++iteration) {
+            const RealVector q = this->multiply(p) + damping * p;
+            const real delta = p.dot(q);
+            if (delta <= 0) {
+                break;
+            }
+
+            const real alpha = gamma / delta;
+            x += alpha * p;
+            s -= alpha * q;
+            z = preconditioner.cwiseProduct(s);
+
+            const real gamma_next = s.dot(z);
+            const real relative = s.norm() / initial_norm;
+            if (verbose) {
+                fmt::print("Normal equations iteration {:4d}: relative residual {:.6e}\n", iteration, relative);
+            }
+            if (relative < tolerance) {
+                break;
+            }
+
+            p = z + (gamma_next / gamma) * p;
+            gamma = gamma_next;
+        }
+        return x;
+    }
+}
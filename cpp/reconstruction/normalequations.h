@@ -0,0 +1,68 @@
+#ifndef ANASTASIS_CPP_NORMALEQUATIONS_H
+#define ANASTASIS_CPP_NORMALEQUATIONS_H
+
+#include <vector>
+
+#include "utils/eigen.h"
+#include "grid/detectorimage.h"
+#include "grid/modelimage.h"
+
+namespace Astar {
+    /** Streaming assembler of the normal equations A^T W A x = A^T W b of the stacked overlap system.
+     *  Exposures are added one at a time: the overlap matrix of each is built, its contribution added
+     *  and then discarded, so the whole A is never held in memory, however many exposures there are.
+     *
+     *  Two model cells are coupled only if a detector pixel overlaps them both, so A^T W A is nonzero only
+     *  for cells at most `radius` apart in both directions. For every cell c the accumulator stores
+     *  the coefficients coupling it to the cells c + (dx, dy) that follow it in row-major order
+     *  (dy = 0 and 0 <= dx <= radius, or 0 < dy <= radius and |dx| <= radius), the rest follows by symmetry.
+     *  The radius must cover the footprint of every pixel: a world pixel spanning w × h model cells needs
+     *  at least ceil(max(w, h)). `coupling_radius` computes it for an exposure, the constructor takes the largest
+     *  over all of them. Memory grows as (radius + 1)(2 radius + 1) per cell, so do not choose it much larger.
+     *
+     *  Like the rest of the reconstruction (CGLS in subpixel, CascadicMultigrid), observations b are the pixel
+     *  values multiplied by the pixel area, so that x comes out as mean values per model cell. Weights apply
+     *  to these scaled observations: a pixel value with variance σ² should be given weight 1 / (area² σ²).
+     *
+     *  Contributions are added in parallel: every thread owns a block of model rows and adds only
+     *  the coefficients and right-hand side entries of the cells in it, so no two threads write the same memory.
+     */
+    class NormalEquations: public virtual AbstractGrid {
+    private:
+        int radius_;
+        int stride_;                    // Number of stored coefficients per cell
+        int threads_;
+        int exposures_ = 0;
+        std::vector<real> coefficients_;
+        RealVector rhs_;
+
+        [[nodiscard]] int slot(int dx, int dy) const;
+        void accumulate(const DetectorImage & image, const storage * weights);
+    public:
+        NormalEquations(pair<int> model_size, int radius, int threads = 1);
+
+        /** Smallest coupling radius that admits every pixel of the exposure(s) **/
+        [[nodiscard]] static int coupling_radius(const DetectorImage & image);
+        [[nodiscard]] static int coupling_radius(const std::vector<DetectorImage> & images);
+
+        /** Add an exposure with unit weights, or with a weight (inverse variance) for every pixel **/
+        NormalEquations & add(const DetectorImage & image);
+        NormalEquations & add(const DetectorImage & image, const Matrix & weights);
+
+        [[nodiscard]] int radius() const { return this->radius_; }
+        [[nodiscard]] int exposures() const { return this->exposures_; }
+        [[nodiscard]] const RealVector & rhs() const { return this->rhs_; }
+        [[nodiscard]] RealVector diagonal() const;
+
+        /** (A^T W A) x **/
+        [[nodiscard]] RealVector multiply(const RealVector & x) const;
+        /** A^T W A as an explicit symmetric sparse matrix, for direct solvers **/
+        [[nodiscard]] RealSparseMatrix matrix() const;
+
+        /** Solve (A^T W A + damping I) x = A^T W b by Jacobi-preconditioned conjugate gradients **/
+        [[nodiscard]] RealVector solve(real damping = 0, real tolerance = 1e-8, int max_iterations = 200,
+                                       bool verbose = false) const;
+    };
+}
+
+#endif //ANASTASIS_CPP_NORMALEQUATIONS_H
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cmath>
+
+#include "richardsonlucy.h"
+
+namespace Astar {
+    RichardsonLucy::RichardsonLucy(const DrizzleOperator & drizzle):
+        drizzle_(drizzle)
+    {}
+
+    RichardsonLucy & RichardsonLucy::set_tolerance(real tolerance) {
+        this->tolerance_ = tolerance;
+        return *this;
+    }
+
+    RichardsonLucy & RichardsonLucy::set_max_iterations(int max_iterations) {
+        this->max_iterations_ = max_iterations;
+        return *this;
+    }
+
+    RichardsonLucy & RichardsonLucy::set_acceleration(bool accelerated) {
+        this->accelerated_ = accelerated;
+        return *this;
+    }
+
+    RichardsonLucy & RichardsonLucy::set_checkpoint(const std::string & filename, int interval) {
+        this->checkpoint_ = filename;
+        this->checkpoint_interval_ = interval;
+        return *this;
+    }
+
+    RichardsonLucy & RichardsonLucy::set_verbose(bool verbose) {
+        this->verbose_ = verbose;
+        return *this;
+    }
+
+    RealVector RichardsonLucy::solve(const RealVector & observations) {
+        // A flat model whose projection carries the same total flux as the observations
+        const real flux = observations.cwiseMax(0).sum();
+        const real coverage = this->drizzle_.adjoint(RealVector::Ones(this->drizzle_.rows())).sum();
+        const real level = ((flux > 0) && (coverage > 0)) ? flux / coverage : 1;
+        return this->solve(observations, RealVector::Constant(this->drizzle_.cols(), level));
+    }
+
+    RealVector RichardsonLucy::solve(const RealVector & observations, const RealVector & initial) {
+        if (observations.size() != this->drizzle_.rows()) {
+            throw std::invalid_argument(fmt::format("Expected {} observations, got {}", this->drizzle_.rows(), observations.size()));
+        }
+        if (initial.size() != this->drizzle_.cols()) {
+            throw std::invalid_argument(fmt::format("Expected initial guess of size {}, got {}", this->drizzle_.cols(), initial.size()));
+        }
+
+        this->history_.clear();
+        this->converged_ = false;
+
+        const RealVector counts = observations.cwiseMax(0);
+        const RealVector sensitivity = this->drizzle_.adjoint(RealVector::Ones(this->drizzle_.rows()));
+
+        RealVector x = initial.cwiseMax(0);
+        RealVector step;                // Last change of the model x_k - x_k-1
+        RealVector update;              // Last multiplicative update, x_k - y_k-1
+        real alpha = 0;
+
+        for (int iteration = 1; iteration <= this->max_iterations_; ++iteration) {
+            const RealVector y = (alpha > 0) ? RealVector(x + alpha * step) : x;
+
+            // One forward pass for the expected counts, one adjoint pass for the correction
+            const RealVector expected = this->drizzle_.forward(y);
+            RealVector ratio(expected.size());
+            real deviance = 0;
+            for (Eigen::Index i = 0; i < expected.size(); ++i) {
+                const real mu = expected[i];
+                const real b = counts[i];
+                ratio[i] = (mu > 0) ? b / mu : 0;
+                if (mu > 0) {
+                    deviance += 2 * (((b > 0) ? b * std::log(b / mu) : 0) - (b - mu));
+                }
+            }
+            const RealVector correction = this->drizzle_.adjoint(ratio);
+
+            // Cells that no pixel sees keep their value
+            RealVector next(y.size());
+            for (Eigen::Index c = 0; c < y.size(); ++c) {
+                next[c] = (sensitivity[c] > 0) ? y[c] * correction[c] / sensitivity[c] : y[c];
+            }
+
+            const real used = alpha;
+            if (this->accelerated_) {
+                // Biggs–Andrews: the step length is the correlation of the last two multiplicative updates
+                const RealVector current = next - y;
+                alpha = 0;
+                if (update.size() > 0) {
+                    const real norm = update.squaredNorm();
+                    alpha = (norm > 0) ? std::clamp(current.dot(update) / norm, 0.0, 1.0) : 0;
+                }
+                update = current;
+            }
+
+            step = next - x;
+            const real norm = next.norm();
+            const real change = (norm > 0) ? step.norm() / norm : 0;
+            x = std::move(next);
+
+            // Never extrapolate past zero, a multiplicative update could not recover from it
+            for (Eigen::Index c = 0; (alpha > 0) && (c < x.size()); ++c) {
+                if (step[c] < 0) {
+                    alpha = std::min(alpha, 0.99 * x[c] / -step[c]);
+                }
+            }
+
+            const RichardsonLucyIteration progress {iteration, deviance, change, used};
+            this->history_.push_back(progress);
+            if (this->verbose_) {
+                fmt::print("Richardson–Lucy iteration {:4d}: deviance {:.6e}, relative change {:.6e}, acceleration {:.3f}\n",
+                           progress.iteration, progress.deviance, progress.change, progress.acceleration);
+            }
+            if ((this->checkpoint_interval_ > 0) && (iteration % this->checkpoint_interval_ == 0)) {
+                this->drizzle_.as_image(x).save_npy(fmt::vformat(this->checkpoint_, fmt::make_format_args(iteration)));
+            }
+            if (change < this->tolerance_) {
+                this->converged_ = true;
+                break;
+            }
+        }
+        return x;
+    }
+}
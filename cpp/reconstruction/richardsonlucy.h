@@ -0,0 +1,65 @@
+#ifndef ANASTASIS_CPP_RICHARDSONLUCY_H
+#define ANASTASIS_CPP_RICHARDSONLUCY_H
+
+#include <string>
+#include <vector>
+
+#include "utils/eigen.h"
+#include "grid/drizzleoperator.h"
+
+namespace Astar {
+    /** Progress of the solver after a single iteration **/
+    struct RichardsonLucyIteration {
+        int iteration;
+        real deviance;              // Poisson deviance 2 Σ [b log(b / Ax) - (b - Ax)] of the model the step started from
+        real change;                // ||x_k - x_k-1|| / ||x_k||
+        real acceleration;          // Extrapolation step that was used, 0 when not accelerated
+    };
+
+    /** Richardson–Lucy (expectation maximisation) reconstruction for photon counts, which keeps the model positive:
+     *
+     *      x <- x * A^T (b / A x) / A^T 1
+     *
+     *  The observations b are expected counts per detector pixel, the same scaling as for least squares
+     *  (mean values times pixel areas); negative values are treated as zero. Every iteration is one forward
+     *  and one adjoint product of the matrix-free DrizzleOperator, both parallel, so no matrix is ever stored.
+     *
+     *  Optionally accelerated by the vector extrapolation of Biggs and Andrews (1997): every step starts from
+     *  the current model extrapolated along the last change, with the step length estimated from the last two
+     *  updates and limited so that the model stays positive. The solver stops when the relative change
+     *  of the model falls below the tolerance, and can save the current model every few iterations.
+     */
+    class RichardsonLucy {
+    private:
+        const DrizzleOperator & drizzle_;
+        real tolerance_ = 1e-4;
+        int max_iterations_ = 100;
+        bool accelerated_ = true;
+        std::string checkpoint_;        // Format string of the checkpoint file name, taking the iteration
+        int checkpoint_interval_ = 0;
+        bool verbose_ = false;
+
+        std::vector<RichardsonLucyIteration> history_;
+        bool converged_ = false;
+    public:
+        /** The operator must outlive the solver **/
+        explicit RichardsonLucy(const DrizzleOperator & drizzle);
+
+        RichardsonLucy & set_tolerance(real tolerance);
+        RichardsonLucy & set_max_iterations(int max_iterations);
+        RichardsonLucy & set_acceleration(bool accelerated);
+        /** Save the current model as .npy every `interval` iterations, e.g. to fmt "out/rl-{:04d}.npy" **/
+        RichardsonLucy & set_checkpoint(const std::string & filename, int interval);
+        RichardsonLucy & set_verbose(bool verbose);
+
+        /** Solve starting from a flat model with the total flux of the observations, or from an initial model **/
+        [[nodiscard]] RealVector solve(const RealVector & observations);
+        [[nodiscard]] RealVector solve(const RealVector & observations, const RealVector & initial);
+
+        [[nodiscard]] const std::vector<RichardsonLucyIteration> & history() const { return this->history_; }
+        [[nodiscard]] bool converged() const { return this->converged_; }
+        [[nodiscard]] int iterations() const { return static_cast<int>(this->history_.size()); }
+    };
+}
+
+#endif //ANASTASIS_CPP_RICHARDSONLUCY_H
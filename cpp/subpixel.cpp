@@ -1,22 +1,134 @@
+#include <filesystem>
 #include <iostream>
+#include <optional>
 
 #include "utils/resample.h"
 #include "utils/eigen.h"
+#include "utils/blocksparse.h"
+#include "grid/overlapcache.h"
+#include "grid/manifest.h"
+#include "reconstruction/cgls.h"
+#include "reconstruction/choleskyfactor.h"
+#include "reconstruction/interlacing.h"
 
 using namespace Astar;
 
-SparseMatrix compute_overlap_matrix(
+BlockSparseMatrix compute_overlap_matrix(
         const std::vector<DetectorImage> & downsampled,
-        const ModelImage & output
+        const ModelImage & output,
+        const std::string & cache_directory                             // reuse the matrices computed by previous runs
 ) {
     fmt::print("Downsampled {:d}\n", downsampled.size());
     std::vector<SparseMatrix> matrices;
+
+    OverlapCache cache(cache_directory);
     for (auto const & image: downsampled) {
-        matrices.emplace_back(output.overlap_matrix(image));
+        matrices.emplace_back(cache.overlap_matrix(output, image));
     }
+    cache.print_statistics();
 
-    SparseMatrix total = hstack(matrices);
-    return total;
+    // Rows are detector pixels, so the exposures are stacked vertically, but kept as separate blocks
+    return BlockSparseMatrix(std::move(matrices), true);
+}
+
+ModelImage reconstruct(
+        Cgls & solver,                                                  // solver set up with the stacked overlaps
+        const std::vector<DetectorImage> & exposures,                   // exposures in the order of stacking
+        pair<int> model_size
+) {
+    // Overlaps are areas while pixels hold mean values, so scale the observations by the pixel areas
+    Eigen::Index rows = 0;
+    for (auto const & exposure: exposures) {
+        rows += exposure.count();
+    }
+    RealVector observations(rows);
+    Eigen::Index offset = 0;
+    for (auto const & exposure: exposures) {
+        observations.segment(offset, exposure.count()) =
+            exposure.data().reshaped<Eigen::RowMajor>().cast<real>() * exposure.pixel_area(0, 0);
+        offset += exposure.count();
+    }
+
+    solver.set_jacobi_preconditioner().set_tolerance(1e-6).set_max_iterations(100).set_verbose(true);
+    RealVector solution = solver.solve(observations);
+    fmt::print("CGLS {} after {} iterations\n", solver.converged() ? "converged" : "stopped", solver.iterations());
+
+    ModelImage model(model_size);
+    model.data() = solution.reshaped<Eigen::RowMajor>(model_size.second, model_size.first).cast<storage>();
+    return model;
+}
+
+std::vector<ModelImage> reconstruct_frames(
+        const std::string & factor_file,                                // LDL^T factor, loaded if it exists, else saved there
+        real damping,                                                   // Tikhonov damping of the normal equations
+        pair<int> model_size,
+        const std::vector<std::string> & manifests                      // one manifest per frame, all with the same placements
+) {
+    std::vector<std::vector<Exposure>> frames;
+    for (auto const & manifest: manifests) {
+        frames.push_back(read_manifest(manifest));
+        const auto & first = frames.front();
+        const auto & frame = frames.back();
+        bool same = frame.size() == first.size();
+        for (std::size_t e = 0; same && (e < frame.size()); ++e) {
+            same = (frame[e].centre.x == first[e].centre.x) && (frame[e].centre.y == first[e].centre.y) &&
+                   (frame[e].physical_size == first[e].physical_size) && (frame[e].rotation == first[e].rotation) &&
+                   (frame[e].pixfrac == first[e].pixfrac);
+        }
+        if (!same) {
+            throw std::runtime_error(fmt::format("Manifest {} does not place its exposures like {}", manifest, manifests[0]));
+        }
+    }
+
+    // The normal matrix depends only on the geometry, so it is factorised once from the first frame, or not at all
+    std::optional<CholeskyFactor> factor;
+    if (std::filesystem::exists(factor_file)) {
+        factor.emplace(CholeskyFactor::load(factor_file, 0));
+        fmt::print("Loaded the factor from {}\n", factor_file);
+    } else {
+        std::vector<DetectorImage> exposures;
+        for (auto const & exposure: frames[0]) {
+            exposures.push_back(exposure.load());
+        }
+        NormalEquations equations(model_size, NormalEquations::coupling_radius(exposures), 0);
+        for (auto const & exposure: exposures) {
+            equations.add(exposure);
+        }
+        factor.emplace(equations, damping, 0);
+        factor->save(factor_file);
+        fmt::print("Factorised the normal equations ({} nonzeros) and saved them to {}\n", factor->nonZeros(), factor_file);
+    }
+    if (factor->size() != static_cast<Eigen::Index>(model_size.first) * model_size.second) {
+        throw std::runtime_error(fmt::format("Factor in {} is for {} cells, not a {}×{} model",
+                                             factor_file, factor->size(), model_size.first, model_size.second));
+    }
+
+    // Right-hand sides A^T b of all frames, exposure by exposure, so that every overlap matrix is built only once
+    RealMatrix rhs = RealMatrix::Zero(factor->size(), static_cast<Eigen::Index>(frames.size()));
+    for (std::size_t e = 0; e < frames[0].size(); ++e) {
+        std::optional<SparseMatrix> overlaps;
+        for (std::size_t f = 0; f < frames.size(); ++f) {
+            const DetectorImage image = frames[f][e].load();
+            if (!overlaps) {
+                overlaps = ModelImage::overlap_matrix(model_size, image, 0);
+            } else if (image.count() != overlaps->rows()) {
+                throw std::runtime_error(fmt::format("Exposure {} has a different size than in the first frame",
+                                                     frames[f][e].filename));
+            }
+            const RealVector observations = image.data().reshaped<Eigen::RowMajor>().cast<real>() * image.pixel_area(0, 0);
+            rhs.col(static_cast<Eigen::Index>(f)) += overlaps->transpose().cast<real>() * observations;
+        }
+    }
+
+    // All frames in one go, one column each
+    const RealMatrix solutions = factor->solve(rhs);
+    std::vector<ModelImage> models;
+    for (Eigen::Index f = 0; f < solutions.cols(); ++f) {
+        ModelImage model(model_size);
+        model.data() = solutions.col(f).reshaped<Eigen::RowMajor>(model_size.second, model_size.first).cast<storage>();
+        models.push_back(std::move(model));
+    }
+    return models;
 }
 
 ModelImage drizzle(
@@ -48,9 +160,17 @@ ModelImage drizzle(
 }
 
 void print_usage(int code) {
-    fmt::print("Usage: subpixel <filename> model_size_x model_size_y subpixel_shifts_x subpixel_shifts_y "
-               "pixfrac_x pixfrac_y\n");
+    fmt::print("Usage: subpixel [--cache <directory>] <filename> model_size_x model_size_y subpixel_shifts_x "
+               "subpixel_shifts_y pixfrac_x pixfrac_y\n");
+    fmt::print("       subpixel --manifest <manifest> model_size_x model_size_y\n");
+    fmt::print("       subpixel --frames <factor> damping model_size_x model_size_y <manifest> [<manifest> ...]\n");
+    fmt::print("--cache <directory> reconstruct by CGLS on explicit overlap matrices, kept in <directory> "
+               "and reused by later runs\n");
+    fmt::print("--frames <factor>   reconstruct every frame, one manifest each with the same placements, by a sparse "
+               "LDL^T factor of the damped normal equations, loaded from <factor> or computed and saved there\n");
     fmt::print("<filename>          path to an 8-bit bmp file\n");
+    fmt::print("<manifest>          list of exposures to drizzle one at a time, one per line: filename centre_x "
+               "centre_y physical_width physical_height rotation pixfrac_x pixfrac_y\n");
     fmt::print("model_size_x        int > 0, number of pixels in horizontal direction for downsampled images\n");
     fmt::print("model_size_y        int > 0, number of pixels in vertical direction for downsampled images\n");
     fmt::print("subpixel_shifts_x   int > 0, number of downsampled images to produce in horizontal direction\n");
@@ -73,8 +193,53 @@ int main(int argc, char * argv[]) {
     real pixfrac_x;
     real pixfrac_y;
 
+    if ((argc > 1) && (args[0] == "--manifest")) {
+        try {
+            if (argc != 5) {
+                print_usage(0);
+            }
+            // Only a few exposures are in memory at any time, however many the manifest lists
+            auto drizzled = drizzle_manifest(args[1], {std::stoi(args[2]), std::stoi(args[3])}, 0);
+            drizzled.save_npy("out/drizzled.npy");
+        } catch (std::invalid_argument & exc) {
+            fmt::print("Aborting due to invalid argument type: {}\n", exc.what());
+            print_usage(1);
+        } catch (std::runtime_error & exc) {
+            fmt::print("Aborting: {}\n", exc.what());
+            std::exit(3);
+        }
+        return 0;
+    }
+
+    if ((argc > 1) && (args[0] == "--frames")) {
+        try {
+            if (argc < 7) {
+                print_usage(0);
+            }
+            const std::vector<std::string> manifests(args.begin() + 5, args.end());
+            auto models = reconstruct_frames(args[1], std::stod(args[2]), {std::stoi(args[3]), std::stoi(args[4])}, manifests);
+            for (std::size_t f = 0; f < models.size(); ++f) {
+                models[f].save_npy(fmt::format("out/frame_{:04d}.npy", f));
+            }
+            fmt::print("Saved {} frames to out/\n", models.size());
+        } catch (std::invalid_argument & exc) {
+            fmt::print("Aborting due to invalid argument type: {}\n", exc.what());
+            print_usage(1);
+        } catch (std::runtime_error & exc) {
+            fmt::print("Aborting: {}\n", exc.what());
+            std::exit(3);
+        }
+        return 0;
+    }
+
+    std::optional<std::string> cache_directory;
+    if ((args.size() >= 2) && (args[0] == "--cache")) {
+        cache_directory = args[1];
+        args.erase(args.begin(), args.begin() + 2);
+    }
+
     try {
-        if (argc != 8) {
+        if (args.size() != 7) {
             print_usage(0);
         }
         model_width = std::stoi(args[1]);
@@ -117,7 +282,26 @@ int main(int argc, char * argv[]) {
         // Save one of the downsampled images so that we can plot it and see what it looks like
         downsampled[0][0].save_npy("out/downsampled.npy");
 
-        compute_overlap_matrix(flatten(downsampled), {model_width, model_height});
+        auto exposures = flatten(downsampled);
+        ModelImage reconstructed(model_width, model_height);
+        if (cache_directory) {
+            auto overlaps = compute_overlap_matrix(exposures, reconstructed, *cache_directory);
+            Cgls solver(overlaps);
+            reconstructed = reconstruct(solver, exposures, reconstructed.size());
+        } else if (auto interlacing = FourierInterlacing::detect(exposures)) {
+            // A regular grid of shifts needs no solve at all
+            fmt::print("Exposures form a regular {}×{} dither, reconstructing by Fourier interlacing\n",
+                       interlacing->factor().first, interlacing->factor().second);
+            reconstructed = interlacing->reconstruct(exposures, reconstructed.size());
+        } else {
+            // The dithered exposures are all aligned, so their overlaps compress to separable stencils
+            StencilMatrix overlaps(reconstructed.size(), exposures);
+            fmt::print("Overlap stencils take {} bytes, an explicit matrix would take {}\n",
+                       overlaps.bytes(), overlaps.explicit_bytes());
+            Cgls solver(overlaps);
+            reconstructed = reconstruct(solver, exposures, reconstructed.size());
+        }
+        reconstructed.save_npy("out/reconstructed.npy");
 
         auto drizzled = drizzle(downsampled, input.size());
         fmt::print("Saving to out/drizzled.npy\n");
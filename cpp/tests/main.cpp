@@ -0,0 +1,96 @@
+#include <cmath>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "tests/tests.h"
+
+namespace Astar::Tests {
+    void check(bool condition, const std::string & message) {
+        if (!condition) {
+            throw std::runtime_error(message);
+        }
+    }
+
+    void check_close(const RealMatrix & actual, const RealMatrix & expected, real tolerance, const std::string & message) {
+        check((actual.rows() == expected.rows()) && (actual.cols() == expected.cols()),
+              fmt::format("{}: shape {}×{}, expected {}×{}", message, actual.cols(), actual.rows(),
+                          expected.cols(), expected.rows()));
+        const real difference = (actual - expected).cwiseAbs().maxCoeff();
+        check(difference <= tolerance, fmt::format("{}: differs by {}, more than {}", message, difference, tolerance));
+    }
+
+    std::filesystem::path scratch(const std::string & name) {
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "anastasis-tests";
+        std::filesystem::create_directories(directory);
+        return directory / name;
+    }
+
+    std::vector<DetectorImage> three_exposures(Point centre, pair<int> model_size) {
+        const real width = model_size.first;
+        const real height = model_size.second;
+        auto grid = [](pair<real> size, real pitch) {
+            return pair<int>(static_cast<int>(std::lround(size.first / pitch)),
+                             static_cast<int>(std::lround(size.second / pitch)));
+        };
+
+        std::vector<DetectorImage> exposures;
+        const pair<real> rotated = {0.8 * width, 0.8 * height};
+        exposures.emplace_back(centre, rotated, 0.3, pair<real>(0.8, 0.8), grid(rotated, 1.4));
+        const pair<real> aligned = {0.9 * width, 0.9 * height};
+        exposures.emplace_back(centre + Point(0.4, -0.3), aligned, 0, pair<real>(0.7, 0.7), grid(aligned, 1.3));
+        const pair<real> diagonal = {0.75 * height, 0.75 * height};
+        exposures.emplace_back(centre + Point(-0.2, 0.2), diagonal, Tau / 8, pair<real>(1, 1), grid(diagonal, 1.2));
+        for (auto && exposure: exposures) {
+            exposure.data() = Matrix::Random(exposure.height(), exposure.width());
+        }
+        return exposures;
+    }
+}
+
+/** Run the named groups of checks, or all of them, and fail if any of them throws **/
+int main(int argc, char * argv[]) {
+    const std::map<std::string, std::function<void()>> groups = {
+        {"bitmap", Astar::Tests::test_bitmap},
+        {"cgls", Astar::Tests::test_cgls},
+        {"choleskyfactor", Astar::Tests::test_choleskyfactor},
+        {"drizzle", Astar::Tests::test_drizzle},
+        {"exposureloader", Astar::Tests::test_exposureloader},
+        {"fits", Astar::Tests::test_fits},
+        {"interlacing", Astar::Tests::test_interlacing},
+        {"kernels", Astar::Tests::test_kernels},
+        {"manifest", Astar::Tests::test_manifest},
+        {"multigrid", Astar::Tests::test_multigrid},
+        {"normalequations", Astar::Tests::test_normalequations},
+        {"npy", Astar::Tests::test_npy},
+        {"operator", Astar::Tests::test_operator},
+        {"overlapcache", Astar::Tests::test_overlapcache},
+        {"richardsonlucy", Astar::Tests::test_richardsonlucy},
+        {"stencils", Astar::Tests::test_stencils},
+    };
+
+    std::vector<std::string> names(argv + 1, argv + argc);
+    if (names.empty()) {
+        for (auto && group: groups) {
+            names.push_back(group.first);
+        }
+    }
+
+    int failures = 0;
+    for (auto && name: names) {
+        const auto group = groups.find(name);
+        if (group == groups.end()) {
+            fmt::print(stderr, "Unknown group of checks '{}'\n", name);
+            ++failures;
+            continue;
+        }
+        try {
+            group->second();
+            fmt::print("{}: passed\n", name);
+        } catch (const std::exception & exception) {
+            fmt::print(stderr, "{}: FAILED: {}\n", name, exception.what());
+            ++failures;
+        }
+    }
+    return (failures == 0) ? 0 : 1;
+}
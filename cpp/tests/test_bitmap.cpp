@@ -0,0 +1,130 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+
+#include "tests/tests.h"
+#include "utils/bitmap.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** Write a BMP whose pixel at (col, row) is given by its bytes, little-endian. Rows are padded with 0xFF
+         *  rather than zeros, so that reading the padding shows. Bit field masks follow the header if there are any. **/
+        void write_bmp(const std::string & filename, int width, int height, int bits, bool top_down,
+                       const std::vector<std::uint32_t> & masks,
+                       const std::function<std::uint32_t(int, int)> & pixel) {
+            const int bytes = bits / 8;
+            const std::size_t stride = (static_cast<std::size_t>(width) * bits + 31) / 32 * 4;
+            const std::size_t offset = sizeof(BITMAPHEADER) + sizeof(BITMAPINFOHEADER) + 4 * masks.size();
+
+            BITMAPHEADER header;
+            header.biOffset = static_cast<unsigned int>(offset);
+            header.biSize = static_cast<unsigned int>(offset + stride * height);
+            BITMAPINFOHEADER info;
+            info.biWidth = width;
+            info.biHeight = top_down ? -height : height;
+            info.biBitCount = static_cast<short>(bits);
+            info.biCompression = masks.empty() ? 0 : 3;
+
+            std::string data(stride * height, '\xFF');
+            for (int row = 0; row < height; ++row) {
+                // Row 0 of the image is the bottom one, which comes first unless the bitmap is top-down
+                const std::size_t start = stride * (top_down ? height - 1 - row : row);
+                for (int col = 0; col < width; ++col) {
+                    const std::uint32_t value = pixel(col, row);
+                    std::memcpy(data.data() + start + static_cast<std::size_t>(col) * bytes, &value, bytes);
+                }
+            }
+
+            std::ofstream out(filename, std::ios::binary);
+            out.write(reinterpret_cast<const char *>(&header), sizeof header);
+            out.write(reinterpret_cast<const char *>(&info), sizeof info);
+            out.write(reinterpret_cast<const char *>(masks.data()), static_cast<std::streamsize>(4 * masks.size()));
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            check(static_cast<bool>(out), fmt::format("Could not write {}", filename));
+        }
+
+        RealMatrix read_bmp(const std::string & filename) {
+            const Bitmap bitmap(filename);
+            Matrix data(bitmap.height(), bitmap.width());
+            bitmap.convert(data.data());
+            return data.cast<real>();
+        }
+
+        /** Channel values of a pixel that differ in every column, row and channel **/
+        std::uint32_t channel(int col, int row, int c) {
+            return static_cast<std::uint32_t>(17 * col + 31 * row + 89 * c) % 256;
+        }
+    }
+
+    void test_bitmap() {
+        // Width 13 gives rows of 39 bytes at 24 bits, padded to 40
+        const int width = 13;
+        const int height = 5;
+        RealMatrix expected(height, width);
+        for (int row = 0; row < height; ++row) {
+            for (int col = 0; col < width; ++col) {
+                expected(row, col) = static_cast<real>(channel(col, row, 0) + channel(col, row, 1) + channel(col, row, 2)) / (3 * 255.0);
+            }
+        }
+        auto bgr = [](int col, int row) { return channel(col, row, 0) | channel(col, row, 1) << 8 | channel(col, row, 2) << 16; };
+        const real tolerance = 1e-6;
+
+        for (bool top_down: {false, true}) {
+            const std::string filename = scratch(top_down ? "padded-top-down.bmp" : "padded.bmp").string();
+            write_bmp(filename, width, height, 24, top_down, {}, bgr);
+            check_close(read_bmp(filename), expected, tolerance, fmt::format("24-bit BMP {}", filename));
+        }
+
+        // The fourth byte of 32-bit pixels is not a channel of the default masks
+        const std::string bgrx = scratch("bgrx.bmp").string();
+        write_bmp(bgrx, width, height, 32, false, {}, [&](int col, int row) { return bgr(col, row) | 0xAB000000u; });
+        check_close(read_bmp(bgrx), expected, tolerance, "32-bit BMP");
+
+        // Grey levels, rows of 13 bytes padded to 16
+        const std::string grey = scratch("grey.bmp").string();
+        write_bmp(grey, width, height, 8, false, {}, [](int col, int row) { return channel(col, row, 0); });
+        const RealMatrix grey_levels = read_bmp(grey);
+        for (int row = 0; row < height; ++row) {
+            for (int col = 0; col < width; ++col) {
+                check(std::abs(grey_levels(row, col) - channel(col, row, 0) / 255.0) <= tolerance,
+                      fmt::format("8-bit BMP differs at ({}, {})", col, row));
+            }
+        }
+
+        // 5-6-5 bit fields, rows of 26 bytes padded to 28
+        const std::string rgb565 = scratch("rgb565.bmp").string();
+        write_bmp(rgb565, width, height, 16, false, {0xF800, 0x07E0, 0x001F}, [](int col, int row) {
+            return (channel(col, row, 0) % 32) << 11 | (channel(col, row, 1) % 64) << 5 | (channel(col, row, 2) % 32);
+        });
+        RealMatrix expected565(height, width);
+        for (int row = 0; row < height; ++row) {
+            for (int col = 0; col < width; ++col) {
+                expected565(row, col) = (channel(col, row, 0) % 32 / 31.0 + channel(col, row, 1) % 64 / 63.0 +
+                                         channel(col, row, 2) % 32 / 31.0) / 3.0;
+            }
+        }
+        check_close(read_bmp(rgb565), expected565, tolerance, "16-bit BMP with bit fields");
+
+        // Heights without a positive absolute value come only from corrupt headers
+        for (int bad: {0, std::numeric_limits<int>::min()}) {
+            const std::string corrupt = scratch("corrupt-height.bmp").string();
+            write_bmp(corrupt, width, height, 8, false, {}, [](int col, int row) { return channel(col, row, 0); });
+            {
+                std::fstream file(corrupt, std::ios::binary | std::ios::in | std::ios::out);
+                file.seekp(sizeof(BITMAPHEADER) + offsetof(BITMAPINFOHEADER, biHeight));
+                file.write(reinterpret_cast<const char *>(&bad), sizeof bad);
+            }
+            bool rejected = false;
+            try {
+                static_cast<void>(Bitmap(corrupt));
+            } catch (const std::runtime_error &) {
+                rejected = true;
+            }
+            check(rejected, fmt::format("BMP of height {} was accepted", bad));
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <limits>
+
+#include "tests/tests.h"
+#include "utils/blocksparse.h"
+#include "reconstruction/cgls.h"
+
+namespace Astar::Tests {
+    /** CGLS must reach the solution of the damped, weighted normal equations through each of its constructors,
+     *  and the Jacobi preconditioner must follow the damping and weights set after it was requested **/
+    void test_cgls() {
+        const pair<int> model_size = {24, 18};
+        const std::vector<DetectorImage> exposures = three_exposures(Point(12, 9), model_size);
+        std::vector<SparseMatrix> blocks;
+        for (auto && exposure: exposures) {
+            blocks.push_back(ModelImage::overlap_matrix(model_size, exposure));
+        }
+        const BlockSparseMatrix stacked(blocks);
+        const SparseMatrix flat = stacked.flatten();
+        const StencilMatrix stencils(model_size, exposures);
+        const DrizzleOperator drizzle(model_size, exposures, 2);
+
+        const RealVector observations = RealVector::Random(flat.rows());
+        const RealVector weights = RealVector::Random(flat.rows()).cwiseAbs() + RealVector::Constant(flat.rows(), 0.5);
+        const real damping = 0.1;
+
+        // Dense solution of (A^T W A + damping I) x = A^T W b
+        const RealMatrix matrix = RealSparseMatrix(flat.cast<real>()).toDense();
+        const RealMatrix normal = matrix.transpose() * weights.asDiagonal() * matrix
+            + damping * RealMatrix::Identity(matrix.cols(), matrix.cols());
+        const RealVector expected = normal.ldlt().solve(matrix.transpose() * weights.cwiseProduct(observations));
+
+        // Products with an explicit matrix in single precision cannot bring the residual much below its epsilon
+        const real convergence = std::max<real>(1e-12, 10 * std::numeric_limits<storage>::epsilon());
+        const real tolerance = std::max<real>(1e-8, 1e4 * std::numeric_limits<storage>::epsilon());
+        auto solved = [&](Cgls solver, const std::string & name) {
+            solver.set_weights(weights).set_damping(damping).set_jacobi_preconditioner()
+                  .set_tolerance(convergence).set_max_iterations(1000);
+            const RealVector x = solver.solve(observations);
+            check(solver.converged(), fmt::format("{}: did not converge in {} iterations", name, solver.iterations()));
+            check_close(x, expected, tolerance, name);
+            return x;
+        };
+
+        solved(Cgls(flat), "Explicit matrix");
+        solved(Cgls(stacked), "Block-sparse matrix");
+        solved(Cgls(stencils), "Stencil matrix");
+        solved(Cgls(drizzle), "Matrix-free operator");
+
+        // The preconditioner is computed from the damping and weights in effect when solving
+        Cgls early(stacked);
+        early.set_jacobi_preconditioner().set_weights(weights).set_damping(damping).set_tolerance(convergence).set_max_iterations(1000);
+        Cgls late(stacked);
+        late.set_weights(weights).set_damping(damping).set_jacobi_preconditioner().set_tolerance(convergence).set_max_iterations(1000);
+        const RealVector x_early = early.solve(observations);
+        const RealVector x_late = late.solve(observations);
+        check(early.iterations() == late.iterations(),
+              fmt::format("Preconditioner set first took {} iterations, set last {}", early.iterations(), late.iterations()));
+        check_close(x_early, x_late, 0, "Preconditioner set before the damping and weights");
+    }
+}
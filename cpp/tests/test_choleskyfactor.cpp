@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <fstream>
+#include <limits>
+
+#include "tests/tests.h"
+#include "reconstruction/choleskyfactor.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** Overwrite the bytes of a copy of the file at `offset`, and return the path of the copy **/
+        template<class T>
+        std::filesystem::path corrupted(const std::filesystem::path & original, const std::string & name,
+                                        std::size_t offset, T value) {
+            const std::filesystem::path path = scratch(name);
+            std::filesystem::copy_file(original, path, std::filesystem::copy_options::overwrite_existing);
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(static_cast<std::streamoff>(offset));
+            file.write(reinterpret_cast<const char *>(&value), sizeof value);
+            return path;
+        }
+
+        void check_rejected(const std::filesystem::path & path, const std::string & what) {
+            bool rejected = false;
+            try {
+                static_cast<void>(CholeskyFactor::load(path.string()));
+            } catch (const std::runtime_error &) {
+                rejected = true;
+            }
+            check(rejected, fmt::format("Factor file with {} was accepted", what));
+        }
+    }
+
+    /** The factor must solve the damped normal equations (A^T A + damping I) x = A^T b assembled from the overlap
+     *  matrices, for one or many frames, survive a round trip through a file and reject corrupt files **/
+    void test_choleskyfactor() {
+        const pair<int> model_size = {20, 16};
+        const std::vector<DetectorImage> exposures = three_exposures(Point(10, 8), model_size);
+        const real damping = 0.05;
+        NormalEquations equations(model_size, NormalEquations::coupling_radius(exposures));
+        RealMatrix normal = damping * RealMatrix::Identity(equations.count(), equations.count());
+        std::vector<RealMatrix> overlaps;
+        for (auto && exposure: exposures) {
+            equations.add(exposure);
+            overlaps.push_back(RealSparseMatrix(ModelImage::overlap_matrix(model_size, exposure).cast<real>()).toDense());
+            normal += overlaps.back().transpose() * overlaps.back();
+        }
+
+        // Several frames with the same geometry, each with its own observations
+        constexpr int Frames = 5;
+        RealMatrix rhs = RealMatrix::Zero(equations.count(), Frames);
+        for (std::size_t e = 0; e < exposures.size(); ++e) {
+            rhs += overlaps[e].transpose() * RealMatrix::Random(overlaps[e].rows(), Frames);
+        }
+        const RealMatrix expected = normal.ldlt().solve(rhs);
+
+        const real tolerance = 1e3 * std::numeric_limits<storage>::epsilon();
+        const CholeskyFactor factor(equations, damping, 2);
+        check_close(factor.solve(RealVector(rhs.col(0))), expected.col(0), tolerance, "Single right-hand side");
+        check_close(factor.solve(rhs), expected, tolerance, "Many right-hand sides");
+
+        // Saved and loaded back, the factor must give the same bits
+        const std::filesystem::path path = scratch("factor.ldl");
+        factor.save(path.string());
+        for (auto && entry: std::filesystem::directory_iterator(path.parent_path())) {
+            check(entry.path().extension() != ".tmp", fmt::format("Saving left {} behind", entry.path().string()));
+        }
+        const CholeskyFactor loaded = CholeskyFactor::load(path.string(), 3);
+        check((loaded.size() == factor.size()) && (loaded.nonZeros() == factor.nonZeros()), "Loaded factor has another shape");
+        check_close(loaded.solve(rhs), factor.solve(rhs), 0, "Loaded factor");
+
+        // Corrupt copies, at the offsets of the documented layout
+        const std::size_t size = static_cast<std::size_t>(factor.size());
+        const std::size_t nonzeros = static_cast<std::size_t>(factor.nonZeros());
+        const std::size_t permutation = 64;
+        const std::size_t outer = permutation + size * sizeof(std::int32_t);
+        const std::size_t inner = outer + (size + 1) * sizeof(std::int32_t);
+        const std::size_t diagonal = (inner + nonzeros * sizeof(std::int32_t) + 7) / 8 * 8;
+        check(nonzeros > 0, "The normal matrix factorised into a diagonal");
+
+        const std::filesystem::path truncated = scratch("truncated.ldl");
+        std::filesystem::copy_file(path, truncated, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::resize_file(truncated, std::filesystem::file_size(path) - 8);
+        check_rejected(truncated, "a truncated end");
+
+        check_rejected(corrupted(path, "negative.ldl", permutation, std::int32_t {-1}), "a negative permutation index");
+        std::int32_t second = 0;
+        {
+            std::ifstream in(path, std::ios::binary);
+            in.seekg(static_cast<std::streamoff>(permutation + sizeof second));
+            in.read(reinterpret_cast<char *>(&second), sizeof second);
+        }
+        check_rejected(corrupted(path, "duplicate.ldl", permutation, second), "a repeated permutation index");
+        check_rejected(corrupted(path, "outer.ldl", outer, std::int32_t {1}), "outer indices not starting at zero");
+        check_rejected(corrupted(path, "upper.ldl", inner, std::int32_t {0}), "an entry on or above the diagonal");
+        check_rejected(corrupted(path, "beyond.ldl", inner, static_cast<std::int32_t>(size)), "a row index out of range");
+        check_rejected(corrupted(path, "zero.ldl", diagonal, real {0}), "a zero in D");
+        check_rejected(corrupted(path, "nan.ldl", diagonal, std::numeric_limits<real>::quiet_NaN()), "a NaN in D");
+    }
+}
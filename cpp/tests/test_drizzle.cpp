@@ -0,0 +1,66 @@
+#include <limits>
+
+#include "tests/tests.h"
+#include "grid/modelimage.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** Unnormalised drizzle straight from the definition, A^T values / pixel area, with A from overlap_matrix **/
+        RealMatrix reference(pair<int> model_size, const DetectorImage & image) {
+            const RealSparseMatrix overlaps = ModelImage::overlap_matrix(model_size, image).cast<real>();
+            const RealVector values = image.data().reshaped<Eigen::RowMajor>().cast<real>();
+            const RealVector sum = overlaps.transpose() * values / image.pixel_area(0, 0);
+            return sum.reshaped<Eigen::RowMajor>(model_size.second, model_size.first);
+        }
+
+        ModelImage drizzled(pair<int> model_size, const DetectorImage & image, int threads, bool deterministic,
+                            bool gather) {
+            ModelImage model(model_size);
+            model.set_threads(threads).set_deterministic(deterministic);
+            if (gather) {
+                model.gather_drizzle(image);
+            } else {
+                model.naive_drizzle(image);
+            }
+            return model;
+        }
+
+        /** Every path of naive and gather drizzle must give the definition, the deterministic one the serial bits **/
+        void check_paths(const std::string & name, pair<int> model_size, const DetectorImage & image) {
+            const real tolerance = 1e3 * std::numeric_limits<storage>::epsilon();
+            const RealMatrix expected = reference(model_size, image);
+            check(expected.cwiseAbs().maxCoeff() > 0.1, fmt::format("{}: the exposure misses the model", name));
+
+            const RealMatrix serial = drizzled(model_size, image, 1, false, false).data().cast<real>();
+            check_close(serial, expected, tolerance, fmt::format("{}: serial scatter", name));
+            for (int threads: {2, 5}) {
+                check_close(drizzled(model_size, image, threads, false, false).data().cast<real>(), expected, tolerance,
+                            fmt::format("{}: scatter into buffers, {} threads", name, threads));
+                check_close(drizzled(model_size, image, threads, true, false).data().cast<real>(), serial, 0,
+                            fmt::format("{}: deterministic scatter, {} threads", name, threads));
+            }
+            for (int threads: {1, 3}) {
+                check_close(drizzled(model_size, image, threads, false, true).data().cast<real>(), expected, tolerance,
+                            fmt::format("{}: gather, {} threads", name, threads));
+            }
+        }
+    }
+
+    void test_drizzle() {
+        const pair<int> model_size = {37, 29};
+
+        // Rotated, so scatter goes through the rasterizer in all its serial, buffered and deterministic forms
+        DetectorImage rotated(Point(18.3, 14.1), pair<real>(30, 22), 0.37, pair<real>(0.7, 0.8), pair<int>(23, 17));
+        rotated.data() = Matrix::Random(rotated.height(), rotated.width());
+        check_paths("rotated", model_size, rotated);
+
+        // Aligned and turned by a right angle, so naive drizzle takes the separable shortcut whatever the threads
+        DetectorImage aligned(Point(17.6, 15.2), pair<real>(31, 21), 0, pair<real>(0.6, 0.9), pair<int>(19, 14));
+        aligned.data() = Matrix::Random(aligned.height(), aligned.width());
+        check_paths("aligned", model_size, aligned);
+
+        DetectorImage turned(Point(19.1, 13.7), pair<real>(24, 20), TauFourth, pair<real>(0.8, 0.5), pair<int>(16, 13));
+        turned.data() = Matrix::Random(turned.height(), turned.width());
+        check_paths("turned", model_size, turned);
+    }
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "tests/tests.h"
+#include "grid/exposureloader.h"
+#include "grid/modelimage.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** Exposures named by their index, all at the same place **/
+        std::vector<Exposure> numbered(int count) {
+            std::vector<Exposure> exposures;
+            for (int i = 0; i < count; ++i) {
+                exposures.push_back({std::to_string(i), Point(6, 5), {12, 10}, 0.1, {1, 1}});
+            }
+            return exposures;
+        }
+
+        /** A small image filled with the index of its exposure, after sleeping for up to `delay` milliseconds **/
+        DetectorImage generated(const Exposure & exposure, int delay) {
+            if (delay > 0) {
+                thread_local std::mt19937 generator(std::hash<std::thread::id>()(std::this_thread::get_id()));
+                std::this_thread::sleep_for(std::chrono::milliseconds(std::uniform_int_distribution(0, delay)(generator)));
+            }
+            DetectorImage image(exposure.centre, exposure.physical_size, exposure.rotation, exposure.pixfrac, pair<int>(4, 3));
+            image.data().setConstant(static_cast<storage>(std::stoi(exposure.filename)));
+            return image;
+        }
+
+        int index_of(const DetectorImage & image) {
+            return static_cast<int>(image.data()(0, 0));
+        }
+    }
+
+    void test_exposureloader() {
+        // Exposures arrive in order whatever order the I/O threads finish them in
+        {
+            ExposureLoader loader(numbered(40), [](const Exposure & exposure) { return generated(exposure, 5); }, 4, 3);
+            int expected = 0;
+            while (auto image = loader.next()) {
+                check(index_of(*image) == expected, fmt::format("Exposure {} delivered as {}", index_of(*image), expected));
+                ++expected;
+            }
+            check(expected == 40, fmt::format("Delivered {} exposures of 40", expected));
+            check(!loader.next(), "Exposures delivered past the end");
+        }
+
+        // No more than capacity + 1 images exist at any time, counting the one being processed
+        for (std::size_t capacity: {1, 2, 4}) {
+            std::atomic<int> live = 0;
+            std::atomic<int> peak = 0;
+            ExposureLoader loader(numbered(30), [&](const Exposure & exposure) {
+                const int now = ++live;
+                int previous = peak.load();
+                while ((now > previous) && !peak.compare_exchange_weak(previous, now)) {}
+                return generated(exposure, 2);
+            }, 4, capacity);
+            while (auto image = loader.next()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(3));
+                --live;
+            }
+            check(peak <= static_cast<int>(capacity) + 1,
+                  fmt::format("{} images were loaded at once with capacity {}", peak.load(), capacity));
+        }
+
+        // A failure is rethrown at its own index only, and the exposures after it still arrive
+        {
+            ExposureLoader loader(numbered(6), [](const Exposure & exposure) {
+                if (exposure.filename == "2") {
+                    throw std::runtime_error("unreadable");
+                }
+                return generated(exposure, 3);
+            }, 3, 2);
+            std::vector<int> delivered;
+            int failures = 0;
+            for (std::size_t i = 0; i < 6; ++i) {
+                try {
+                    auto image = loader.next();
+                    check(image.has_value(), fmt::format("Exposure {} is missing", i));
+                    delivered.push_back(index_of(*image));
+                } catch (const std::runtime_error & exception) {
+                    check((i == 2) && (std::string(exception.what()) == "unreadable"),
+                          fmt::format("Exposure {} failed with '{}'", i, exception.what()));
+                    ++failures;
+                }
+            }
+            check((failures == 1) && (delivered == std::vector<int> {0, 1, 3, 4, 5}), "Exposures around the failure were lost");
+            check(!loader.next(), "Exposures delivered past the end");
+        }
+
+        // Abandoning a loader with exposures still loading or waiting for room must not hang
+        for (int taken: {0, 1, 3}) {
+            ExposureLoader loader(numbered(20), [](const Exposure & exposure) { return generated(exposure, 10); }, 3, 2);
+            for (int i = 0; i < taken; ++i) {
+                static_cast<void>(loader.next());
+            }
+        }
+
+        // Drizzling the stream of files is the same as drizzling them all from memory
+        std::vector<Exposure> files;
+        std::vector<DetectorImage> images;
+        for (int i = 0; i < 5; ++i) {
+            const Exposure exposure {scratch(fmt::format("loader-{}.npy", i)).string(), Point(10.3 + 0.2 * i, 8.1),
+                                     {16, 12}, 0.15 * i, {0.8, 0.9}};
+            DetectorImage image(exposure.centre, exposure.physical_size, exposure.rotation, exposure.pixfrac, pair<int>(11, 9));
+            image.data() = Matrix::Random(9, 11);
+            image.save_npy(exposure.filename);
+            files.push_back(exposure);
+            images.push_back(std::move(image));
+        }
+        ModelImage streamed(pair<int>(20, 16));
+        ExposureLoader loader(files, 2, 2);
+        streamed.naive_drizzle(loader);
+        ModelImage direct(pair<int>(20, 16));
+        direct.naive_drizzle(images);
+        check_close(streamed.data().cast<real>(), direct.data().cast<real>(), 0, "Drizzle of the loaded stream");
+    }
+}
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numbers>
+
+#include "tests/tests.h"
+#include "grid/modelimage.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** Write a primary HDU with BITPIX -32 or -64 by hand, independently of Image::save_fits **/
+        template<class T>
+        void write_fits(const std::string & filename, const RealMatrix & data, const std::vector<std::string> & cards = {}) {
+            typedef std::conditional_t<sizeof(T) == 8, std::uint64_t, std::uint32_t> Word;
+            std::vector<std::string> header = {
+                fits_card("SIMPLE", "T"),
+                fits_card("BITPIX", std::to_string(-8 * static_cast<int>(sizeof(T)))),
+                fits_card("NAXIS", "2"),
+                fits_card("NAXIS1", std::to_string(data.cols())),
+                fits_card("NAXIS2", std::to_string(data.rows())),
+            };
+            header.insert(header.end(), cards.begin(), cards.end());
+
+            const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> values = data.cast<T>();
+            std::vector<Word> words(values.size());
+            std::memcpy(words.data(), values.data(), words.size() * sizeof(Word));
+            if constexpr (std::endian::native == std::endian::little) {
+                for (auto && word: words) {
+                    word = std::byteswap(word);
+                }
+            }
+
+            std::string text = fits_header(header);
+            text.append(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(Word));
+            text.append((FitsFile::BlockSize - text.size() % FitsFile::BlockSize) % FitsFile::BlockSize, '\0');
+            std::ofstream out(filename, std::ios::binary);
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+            check(static_cast<bool>(out), fmt::format("Could not write {}", filename));
+        }
+
+        /** Write the header cards and big-endian values, padded to whole blocks **/
+        template<class T>
+        std::string fits_unit(const std::vector<std::string> & cards, const std::vector<T> & values) {
+            std::string text = fits_header(cards);
+            for (T value: values) {
+                char bytes[sizeof(T)];
+                std::memcpy(bytes, &value, sizeof value);
+                if constexpr (std::endian::native == std::endian::little) {
+                    std::reverse(bytes, bytes + sizeof bytes);
+                }
+                text.append(bytes, sizeof bytes);
+            }
+            text.append((FitsFile::BlockSize - text.size() % FitsFile::BlockSize) % FitsFile::BlockSize, '\0');
+            return text;
+        }
+
+        /** An IMAGE extension after a primary HDU without data, holding integers scaled by BSCALE and BZERO,
+         *  with BLANK marking the undefined pixels **/
+        template<class T>
+        void check_integer_extension() {
+            constexpr int Bitpix = 8 * static_cast<int>(sizeof(T));
+            const T blank = std::is_signed_v<T> ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+            const int width = 7;
+            const int height = 4;
+            std::vector<T> values;
+            RealMatrix expected(height, width);
+            for (int row = 0; row < height; ++row) {
+                for (int col = 0; col < width; ++col) {
+                    const T value = static_cast<T>(((5 * row + 3 * col) % 23) - (std::is_signed_v<T> ? 11 : 0));
+                    values.push_back(((row + col) % 5 == 2) ? blank : value);
+                    expected(row, col) = ((row + col) % 5 == 2) ? 0.0 : 0.25 * value + 1000;
+                }
+            }
+
+            const std::string filename = scratch(fmt::format("extension{}.fits", Bitpix)).string();
+            std::ofstream out(filename, std::ios::binary);
+            out << fits_unit<T>({
+                fits_card("SIMPLE", "T"), fits_card("BITPIX", "8"), fits_card("NAXIS", "0"), fits_card("EXTEND", "T"),
+            }, {});
+            out << fits_unit<T>({
+                fits_card("XTENSION", "'IMAGE'"), fits_card("BITPIX", std::to_string(Bitpix)), fits_card("NAXIS", "2"),
+                fits_card("NAXIS1", std::to_string(width)), fits_card("NAXIS2", std::to_string(height)),
+                fits_card("PCOUNT", "0"), fits_card("GCOUNT", "1"), fits_card("BSCALE", "0.25"),
+                fits_card("BZERO", "1000"), fits_card("BLANK", std::to_string(static_cast<long long>(blank))),
+            }, values);
+            out.close();
+
+            const FitsFile fits(filename);
+            check(fits.count() == 2, fmt::format("Read {} HDUs, expected 2", fits.count()));
+            check(!fits.hdu(0).is_image(), "Primary HDU without data taken for an image");
+            check(fits.first_image() == 1, fmt::format("First image is HDU {}, expected 1", fits.first_image()));
+            check(fits.hdu(1).bitpix == Bitpix, fmt::format("Extension has BITPIX {}", fits.hdu(1).bitpix));
+
+            RealMatrix actual = fits.matrix(1).cast<real>();
+            for (int row = 0; row < height; ++row) {
+                for (int col = 0; col < width; ++col) {
+                    check(std::isnan(actual(row, col)) == ((row + col) % 5 == 2),
+                          fmt::format("BITPIX {}: pixel {}, {} is {}", Bitpix, col, row, actual(row, col)));
+                    if (std::isnan(actual(row, col))) {
+                        actual(row, col) = 0;
+                    }
+                }
+            }
+            check_close(actual, expected, 0, fmt::format("IMAGE extension with BITPIX {}", Bitpix));
+        }
+
+        /** Negative axes, whose product wraps around to a small size, and overflowing products must be rejected **/
+        void check_corrupt_header(const std::string & name, const std::vector<std::string> & axes) {
+            std::vector<std::string> cards = {fits_card("SIMPLE", "T"), fits_card("BITPIX", "-64")};
+            cards.insert(cards.end(), axes.begin(), axes.end());
+            const std::string filename = scratch(fmt::format("{}.fits", name)).string();
+            std::ofstream out(filename, std::ios::binary);
+            out << fits_unit<double>(cards, {1.0});
+            out.close();
+
+            bool rejected = false;
+            try {
+                static_cast<void>(FitsFile(filename));
+            } catch (const std::runtime_error &) {
+                rejected = true;
+            }
+            check(rejected, fmt::format("FITS header with {} axes was accepted", name));
+        }
+
+        /** Save an image with Image::save_fits and read it back through FitsFile **/
+        void check_save_fits() {
+            ModelImage image(7, 5);
+            image.data() = Matrix::Random(5, 7);
+            const std::string filename = scratch("saved.fits").string();
+            image.save_fits(filename, {fits_card("OBJECT", "'random'")});
+
+            const FitsFile fits(filename);
+            check(fits.hdu(0).bitpix == fits_bitpix(), fmt::format("Saved with BITPIX {}", fits.hdu(0).bitpix));
+            check(fits.hdu(0).header.text("OBJECT") == "random", "Extra card was not saved");
+            check_close(fits.matrix(0).cast<real>(), image.data().cast<real>(), 0, "FITS saved by Image");
+        }
+
+        /** Read back floating-point data of either precision, whatever `storage` is **/
+        template<class T>
+        void check_bitpix() {
+            // Values exactly representable as float, so that only the precision of `storage` matters
+            const RealMatrix expected = Eigen::MatrixXf::Random(6, 9).cast<real>();
+            const std::string filename = scratch(fmt::format("bitpix{}.fits", 8 * sizeof(T))).string();
+            write_fits<T>(filename, expected);
+
+            const FitsFile fits(filename);
+            check(fits.hdu(0).bitpix == -8 * static_cast<int>(sizeof(T)), "Wrong BITPIX");
+            check_close(fits.matrix(0).cast<real>(), expected, 0, fmt::format("FITS with BITPIX -{}", 8 * sizeof(T)));
+        }
+
+        /** The same linear WCS written as CD, as PC with CDELT, and as CDELT with CROTA2 must place the image alike.
+         *  The pixel axes have opposite signs of CDELT, as on the sky, so that applying CDELT to the columns
+         *  rather than the rows of PC would reverse the rotation. **/
+        void check_placement() {
+            const real rho = 30.0 * std::numbers::pi / 180.0;
+            const real cdelt1 = -2e-4;
+            const real cdelt2 = 2e-4;
+            Eigen::Matrix2d cd;
+            cd(0, 0) = cdelt1 * std::cos(rho);
+            cd(0, 1) = -cdelt2 * std::sin(rho);
+            cd(1, 0) = cdelt1 * std::sin(rho);
+            cd(1, 1) = cdelt2 * std::cos(rho);
+            const Eigen::Matrix2d pc = Eigen::Vector2d(1.0 / cdelt1, 1.0 / cdelt2).asDiagonal() * cd;
+
+            const std::vector<std::string> common = {
+                fits_card("CTYPE1", "'RA---TAN'"),
+                fits_card("CTYPE2", "'DEC--TAN'"),
+                fits_card("CRPIX1", "10.5"),
+                fits_card("CRPIX2", "4.0"),
+                fits_card("CRVAL1", "150.01"),
+                fits_card("CRVAL2", "2.2"),
+            };
+            auto with = [&common](const std::vector<std::string> & cards) {
+                std::vector<std::string> all = common;
+                all.insert(all.end(), cards.begin(), cards.end());
+                return all;
+            };
+            auto number = [](real value) { return fmt::format("{:.17g}", value); };
+
+            const RealMatrix data = RealMatrix::Zero(12, 20);
+            const std::string cd_file = scratch("cd.fits").string();
+            const std::string pc_file = scratch("pc.fits").string();
+            const std::string crota_file = scratch("crota.fits").string();
+            write_fits<double>(cd_file, data, with({
+                fits_card("CD1_1", number(cd(0, 0))), fits_card("CD1_2", number(cd(0, 1))),
+                fits_card("CD2_1", number(cd(1, 0))), fits_card("CD2_2", number(cd(1, 1))),
+            }));
+            write_fits<double>(pc_file, data, with({
+                fits_card("CDELT1", number(cdelt1)), fits_card("CDELT2", number(cdelt2)),
+                fits_card("PC1_1", number(pc(0, 0))), fits_card("PC1_2", number(pc(0, 1))),
+                fits_card("PC2_1", number(pc(1, 0))), fits_card("PC2_2", number(pc(1, 1))),
+            }));
+            write_fits<double>(crota_file, data, with({
+                fits_card("CDELT1", number(cdelt1)), fits_card("CDELT2", number(cdelt2)),
+                fits_card("CROTA2", number(30.0)),
+            }));
+
+            const WcsFrame frame = {Point(150, 2), Point(100, 50), 1e-4};
+            const WcsPlacement expected = FitsFile(cd_file).placement(0, frame);
+            for (auto && filename: {pc_file, crota_file}) {
+                const WcsPlacement placement = FitsFile(filename).placement(0, frame);
+                const real difference = std::max({
+                    std::abs(placement.centre.x - expected.centre.x), std::abs(placement.centre.y - expected.centre.y),
+                    std::abs(placement.physical_size.first - expected.physical_size.first),
+                    std::abs(placement.physical_size.second - expected.physical_size.second),
+                    std::abs(std::remainder(placement.rotation - expected.rotation, 2 * std::numbers::pi)),
+                });
+                check(difference < 1e-9, fmt::format("Placement from {} differs from the CD one by {}", filename, difference));
+            }
+            // The first axis is reversed to undo the sky parity, so a positive CROTA2 turns the image clockwise
+            check(std::abs(expected.rotation + rho) < 1e-12,
+                  fmt::format("Rotation is {} rad, expected {}", expected.rotation, -rho));
+        }
+    }
+
+    void test_fits() {
+        check_save_fits();
+        check_bitpix<float>();
+        check_bitpix<double>();
+        check_integer_extension<std::uint8_t>();
+        check_integer_extension<std::int16_t>();
+        check_integer_extension<std::int32_t>();
+        check_placement();
+        check_corrupt_header("negative", {
+            fits_card("NAXIS", "2"), fits_card("NAXIS1", "-1"), fits_card("NAXIS2", "-1"),
+        });
+        check_corrupt_header("overflowing", {
+            fits_card("NAXIS", "2"), fits_card("NAXIS1", "4294967296"), fits_card("NAXIS2", "4294967296"),
+        });
+        check_corrupt_header("negative-count", {
+            fits_card("NAXIS", "1"), fits_card("NAXIS1", "1"), fits_card("GCOUNT", "-1"),
+        });
+    }
+}
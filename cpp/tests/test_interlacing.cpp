@@ -0,0 +1,133 @@
+#include <cmath>
+#include <limits>
+#include <optional>
+
+#include "tests/tests.h"
+#include "reconstruction/interlacing.h"
+
+namespace Astar::Tests {
+    namespace {
+        constexpr pair<int> Factor = {3, 2};
+        constexpr pair<int> GridSize = {14, 16};
+
+        /** Regular 3×2 dither of pixels 3×2 model cells large, so the interlaced grid is the model grid.
+         *  The pixels of the lowest exposure are centred on model cells, the others are shifted by whole cells. **/
+        std::vector<DetectorImage> dither(pair<real> pixfrac) {
+            const pair<real> physical_size = {Factor.first * GridSize.first, Factor.second * GridSize.second};
+            std::vector<DetectorImage> exposures;
+            for (int j = 0; j < Factor.second; ++j) {
+                for (int i = 0; i < Factor.first; ++i) {
+                    const Point centre = {i + physical_size.first / 2, j - 0.5 + physical_size.second / 2};
+                    exposures.emplace_back(centre, physical_size, 0, pixfrac, GridSize);
+                }
+            }
+            return exposures;
+        }
+
+        /** Pixels of the exposures hold the mean of the truth over their footprints **/
+        void observe(std::vector<DetectorImage> & exposures, const ModelImage & truth) {
+            const RealVector cells = truth.data().cast<real>().reshaped<Eigen::RowMajor>();
+            for (auto && exposure: exposures) {
+                const RealVector means = ModelImage::overlap_matrix(truth.size(), exposure).cast<real>() * cells
+                                         / exposure.pixel_area(0, 0);
+                exposure.data() = means.reshaped<Eigen::RowMajor>(exposure.height(), exposure.width()).cast<storage>();
+            }
+        }
+
+        void check_rejected(std::vector<DetectorImage> exposures, const std::string & what) {
+            const auto interlacing = FourierInterlacing::detect(exposures);
+            check(!interlacing.has_value(), fmt::format("{} were taken for a regular {}×{} dither", what,
+                                                        interlacing ? interlacing->factor().first : 0,
+                                                        interlacing ? interlacing->factor().second : 0));
+        }
+    }
+
+    /** Interlacing a regular dither and deconvolving the pixel response must give back the scene it was observed from,
+     *  and anything that is not exactly such a dither must be left to the solvers **/
+    void test_interlacing() {
+        // A smooth scene that vanishes towards the edges, so that treating it as periodic costs nothing
+        const pair<int> model_size = {44, 34};
+        ModelImage truth(model_size);
+        for (int y = 0; y < model_size.second; ++y) {
+            for (int x = 0; x < model_size.first; ++x) {
+                auto blob = [&](real cx, real cy, real sigma) {
+                    return std::exp(-((x + 0.5 - cx) * (x + 0.5 - cx) + (y + 0.5 - cy) * (y + 0.5 - cy)) / (2 * sigma * sigma));
+                };
+                truth.data()(y, x) = static_cast<storage>(blob(18.3, 15.6, 3) + 0.6 * blob(25.2, 16.4, 2.5));
+            }
+        }
+
+        // Rounding of the observations is amplified where the response is weak, so single precision regularises more
+        const real regularisation = std::max<real>(1e-10, std::numeric_limits<storage>::epsilon());
+        const real tolerance = std::max<real>(1e-4, 1e3 * std::numeric_limits<storage>::epsilon());
+        for (pair<real> pixfrac: {pair<real>(1, 1), pair<real>(0.8, 0.8), pair<real>(0.6, 0.9)}) {
+            const std::string name = fmt::format("pixfrac {}×{}", pixfrac.first, pixfrac.second);
+            std::vector<DetectorImage> exposures = dither(pixfrac);
+            observe(exposures, truth);
+
+            const auto interlacing = FourierInterlacing::detect(exposures);
+            check(interlacing.has_value(), fmt::format("{}: regular dither not detected", name));
+            check(interlacing->factor() == Factor, fmt::format("{}: detected a {}×{} dither", name,
+                                                               interlacing->factor().first, interlacing->factor().second));
+
+            // Pixel (col, row) of exposure (i, j) lands on fine pixel (3 col + i, 2 row + j)
+            const DetectorImage fine = interlacing->interlace(exposures);
+            check(fine.size() == pair<int>(Factor.first * GridSize.first, Factor.second * GridSize.second),
+                  fmt::format("{}: interlaced image is {}×{}", name, fine.width(), fine.height()));
+            for (int j = 0; j < Factor.second; ++j) {
+                for (int i = 0; i < Factor.first; ++i) {
+                    const Matrix & data = exposures[Factor.first * j + i].data();
+                    for (int row = 0; row < GridSize.second; ++row) {
+                        for (int col = 0; col < GridSize.first; ++col) {
+                            check(fine.data()(Factor.second * row + j, Factor.first * col + i) == data(row, col),
+                                  fmt::format("{}: pixel {}, {} of exposure {}, {} misplaced", name, col, row, i, j));
+                        }
+                    }
+                }
+            }
+
+            // Away from the edges of the interlaced grid, which cover cells [0, 42) × [0, 32)
+            const ModelImage model = interlacing->reconstruct(exposures, model_size, regularisation);
+            const RealMatrix interior = model.data().cast<real>().block(4, 4, 24, 34);
+            const RealMatrix expected = truth.data().cast<real>().block(4, 4, 24, 34);
+            check_close(interior, expected, tolerance, fmt::format("{}: deconvolved reconstruction", name));
+
+            // The interlaced image alone is still blurred by the footprints, which the deconvolution must remove
+            const real blurred = (fine.data().cast<real>().block(4, 4, 24, 34) - expected).cwiseAbs().maxCoeff();
+            check(blurred > 10 * tolerance, fmt::format("{}: footprints blur the scene by only {}", name, blurred));
+        }
+
+        // Anything else must be left to the solvers
+        const std::vector<DetectorImage> regular = dither({1, 1});
+
+        std::vector<DetectorImage> rotated = regular;
+        for (auto && exposure: rotated) {
+            exposure <<= 0.1;
+        }
+        check_rejected(rotated, "Rotated exposures");
+
+        std::vector<DetectorImage> irregular = regular;
+        irregular[4] += Point(0.37, 0);
+        check_rejected(irregular, "Exposures shifted by an arbitrary fraction of a pixel");
+
+        std::vector<DetectorImage> spread = regular;
+        for (auto && exposure: spread) {
+            exposure += Point(exposure.centre().x - regular.front().centre().x, 0);
+        }
+        check_rejected(spread, "Exposures shifted by more than a pixel");
+
+        std::vector<DetectorImage> incomplete = regular;
+        incomplete.erase(incomplete.begin() + 2);
+        check_rejected(incomplete, "Five of six exposures");
+
+        std::vector<DetectorImage> duplicate = regular;
+        duplicate[5] = duplicate[1];
+        check_rejected(duplicate, "Exposures with a repeated shift");
+
+        std::vector<DetectorImage> mixed = regular;
+        mixed[3] = DetectorImage(mixed[3].centre(), mixed[3].physical_size(), 0, {0.8, 0.8}, GridSize);
+        check_rejected(mixed, "Exposures with different pixfrac");
+
+        check_rejected({regular.front()}, "A single exposure");
+    }
+}
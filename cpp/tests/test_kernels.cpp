@@ -0,0 +1,94 @@
+#include <map>
+#include <random>
+
+#include "tests/tests.h"
+#include "grid/box.h"
+#include "grid/pixel/coverage.h"
+#include "grid/pixel/pixelbatch.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** A pixel with random position, size, aspect ratio and rotation, around the cells near the origin **/
+        Pixel random_pixel(std::mt19937_64 & generator) {
+            std::uniform_real_distribution<real> position(-3, 3);
+            std::uniform_real_distribution<real> size(0.2, 3);
+            std::uniform_real_distribution<real> angle(0, Tau);
+            const Point centre(position(generator), position(generator));
+            const real rotation = angle(generator);
+            const Point u = Point(std::cos(rotation), std::sin(rotation)) * (0.5 * size(generator));
+            const Point v = Point(-std::sin(rotation), std::cos(rotation)) * (0.5 * size(generator));
+            return Pixel(centre - u - v, centre + u - v, centre - u + v, centre + u + v);
+        }
+
+        /** Overlaps of a pixel with all cells of the window, from the coverage rasterizer used by overlap_matrix **/
+        RealMatrix rasterized(const Pixel & pixel, const Box & window) {
+            RealMatrix areas = RealMatrix::Zero(window.top - window.bottom, window.right - window.left);
+            CoverageRasterizer rasterizer;
+            rasterizer.rasterize(pixel);
+            rasterizer.for_each(window, 0, [&](int x, int y, real area) {
+                areas(y - window.bottom, x - window.left) = area;
+            });
+            return areas;
+        }
+    }
+
+    /** Every instruction set available here must agree with the scalar kernel and with the coverage rasterizer,
+     *  and the vector instruction sets, built from the same source without contraction, bit for bit **/
+    void test_kernels() {
+        const std::vector<std::string> kernels = overlap_kernels();
+        check(kernels.back() == "scalar", "The scalar kernel must always be available");
+        fmt::print("Overlap kernels available: {}\n", fmt::join(kernels, ", "));
+
+        const Box window(-6, 6, -6, 6);
+        const int width = window.right - window.left;
+        const real tolerance = 1e-12;
+        std::mt19937_64 generator(12345);
+
+        std::vector<Pixel> pixels;
+        PixelBatch batch;
+        for (int i = 0; i < 203; ++i) {
+            pixels.push_back(random_pixel(generator));
+            batch.push_back(pixels.back());
+        }
+
+        std::map<std::string, RealMatrix> rows;
+        std::map<std::string, RealMatrix> batches;
+        for (auto && kernel: kernels) {
+            // Row kernel: every pixel against every row of the window, all cells of the window as columns
+            RealMatrix & by_row = rows[kernel];
+            by_row.resize(static_cast<Eigen::Index>(pixels.size()) * width, width);
+            for (std::size_t p = 0; p < pixels.size(); ++p) {
+                for (int y = window.bottom; y < window.top; ++y) {
+                    overlap_row(pixels[p], window.left, y, width, by_row.row(p * width + y - window.bottom).data(), kernel);
+                }
+            }
+
+            // Batch kernel: all pixels against every cell of the window
+            RealMatrix & by_cell = batches[kernel];
+            by_cell.resize(width * width, static_cast<Eigen::Index>(pixels.size()));
+            for (int y = window.bottom; y < window.top; ++y) {
+                for (int x = window.left; x < window.right; ++x) {
+                    overlap_batch(batch, x, y, by_cell.row(width * (y - window.bottom) + x - window.left).data(), kernel);
+                }
+            }
+        }
+
+        for (auto && kernel: kernels) {
+            check_close(rows[kernel], rows["scalar"], tolerance, fmt::format("Row kernel {} against scalar", kernel));
+            check_close(batches[kernel], batches["scalar"], tolerance, fmt::format("Batch kernel {} against scalar", kernel));
+            if (kernel != "scalar") {
+                check_close(rows[kernel], rows[kernels.front()], 0, fmt::format("Row kernel {} against {}", kernel, kernels.front()));
+                check_close(batches[kernel], batches[kernels.front()], 0, fmt::format("Batch kernel {} against {}", kernel, kernels.front()));
+            }
+        }
+
+        for (std::size_t p = 0; p < pixels.size(); ++p) {
+            const RealMatrix expected = rasterized(pixels[p], window);
+            const RealMatrix row_overlaps = rows[kernels.front()].middleRows(p * width, width);
+            const RealMatrix batch_overlaps = batches[kernels.front()].col(p).reshaped<Eigen::RowMajor>(width, width);
+            check_close(row_overlaps, expected, tolerance, fmt::format("Row kernel against the rasterizer, pixel {}", p));
+            check_close(batch_overlaps, expected, tolerance, fmt::format("Batch kernel against the rasterizer, pixel {}", p));
+            check(std::abs(expected.sum() - pixels[p].area()) < tolerance, fmt::format("Rasterized area of pixel {}", p));
+        }
+    }
+}
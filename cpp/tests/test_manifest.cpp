@@ -0,0 +1,61 @@
+#include <fstream>
+#include <limits>
+
+#include "tests/tests.h"
+#include "grid/manifest.h"
+
+namespace Astar::Tests {
+    /** Manifests must read back the same files after being written elsewhere, also when they are given by relative
+     *  paths, and streaming the exposures they list must give the same drizzle as drizzling them from memory **/
+    void test_manifest() {
+        const std::filesystem::path directory = scratch("manifest") / "m";
+        std::filesystem::create_directories(directory);
+        // Relative to the working directory, like a manifest named on the command line
+        const std::filesystem::path relative = std::filesystem::relative(directory, std::filesystem::current_path());
+        check(relative.is_relative(), "Scratch directory has no relative path");
+
+        std::vector<DetectorImage> images;
+        std::string text = "# Three tiny exposures\n\n";
+        for (int i = 0; i < 3; ++i) {
+            const std::string name = fmt::format("img{}.npy", i);
+            DetectorImage image(Point(9.4 + 0.3 * i, 7.6 - 0.2 * i), pair<real>(14, 11), 0.2 * i, pair<real>(0.9, 0.8), pair<int>(10, 8));
+            image.data() = Matrix::Random(8, 10);
+            image.save_npy((directory / name).string());
+            text += fmt::format("{} {} {} {} {} {} {} {}  # exposure {}\n", name, image.centre().x, image.centre().y,
+                                14, 11, 0.2 * i, 0.9, 0.8, i);
+            images.push_back(std::move(image));
+        }
+        const std::string manifest = (relative / "a.txt").string();
+        std::ofstream(manifest) << text;
+
+        // Read, write to another directory and to the same one, read back
+        const std::vector<Exposure> original = read_manifest(manifest);
+        check(original.size() == 3, fmt::format("Manifest lists {} exposures, expected 3", original.size()));
+        const std::filesystem::path elsewhere = relative.parent_path() / "copy";
+        std::filesystem::create_directories(elsewhere);
+        for (const std::string & copy: {(elsewhere / "b.txt").string(), (relative / "c.txt").string()}) {
+            write_manifest(copy, original);
+            const std::vector<Exposure> again = read_manifest(copy);
+            check(again.size() == original.size(), fmt::format("{} lists {} exposures", copy, again.size()));
+            for (std::size_t e = 0; e < again.size(); ++e) {
+                check(std::filesystem::exists(again[e].filename) &&
+                      std::filesystem::equivalent(again[e].filename, original[e].filename),
+                      fmt::format("{} names {} instead of {}", copy, again[e].filename, original[e].filename));
+                check((again[e].centre.x == original[e].centre.x) && (again[e].centre.y == original[e].centre.y) &&
+                      (again[e].physical_size == original[e].physical_size) && (again[e].rotation == original[e].rotation) &&
+                      (again[e].pixfrac == original[e].pixfrac), fmt::format("{} moved exposure {}", copy, e));
+            }
+        }
+
+        // Streaming the manifest averages the drizzles of its exposures
+        const pair<int> model_size = {18, 14};
+        ModelImage direct(model_size);
+        direct.naive_drizzle(images);
+        direct *= 1.0 / static_cast<real>(images.size());
+        for (int threads: {1, 2}) {
+            const ModelImage streamed = drizzle_manifest(manifest, model_size, threads, 2);
+            check_close(streamed.data().cast<real>(), direct.data().cast<real>(), 1e3 * std::numeric_limits<storage>::epsilon(),
+                        fmt::format("Drizzle of the manifest, {} threads", threads));
+        }
+    }
+}
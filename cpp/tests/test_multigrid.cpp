@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <limits>
+
+#include "tests/tests.h"
+#include "grid/drizzleoperator.h"
+#include "reconstruction/cgls.h"
+#include "reconstruction/multigrid.h"
+
+namespace Astar::Tests {
+    /** Cascadic multigrid only changes where the finest level starts, so it must end at the solution
+     *  of the same damped least squares problem as CGLS on the finest model alone **/
+    void test_multigrid() {
+        const pair<int> model_size = {32, 24};
+        std::vector<DetectorImage> exposures = three_exposures(Point(16, 12), model_size);
+        for (auto && exposure: exposures) {
+            exposure.data() = exposure.data().cwiseAbs();
+        }
+        const real damping = 0.05;
+
+        // Single level: observations scaled by the pixel areas, like the finest level of the multigrid
+        const DrizzleOperator drizzle(model_size, exposures, 2);
+        RealVector observations = drizzle.observations();
+        for (std::size_t e = 0; e < exposures.size(); ++e) {
+            observations.segment(drizzle.offset(e), exposures[e].count()) *= exposures[e].pixel_area(0, 0);
+        }
+        Cgls single(drizzle);
+        single.set_damping(damping).set_jacobi_preconditioner().set_tolerance(1e-12).set_max_iterations(1000);
+        const RealVector expected = single.solve(observations);
+        check(single.converged(), "Single-level CGLS did not converge");
+
+        CascadicMultigrid multigrid(model_size, exposures, 3, 2);
+        multigrid.set_damping(damping).set_tolerance(1e-12).set_max_iterations(1000);
+        const ModelImage model = multigrid.solve();
+
+        const auto & history = multigrid.history();
+        check(history.size() == 3, fmt::format("Multigrid solved {} levels, expected 3", history.size()));
+        check((history[0].model_size == pair<int>(8, 6)) && (history[1].model_size == pair<int>(16, 12)) &&
+              (history[2].model_size == model_size), "Multigrid levels do not halve the model");
+        check(std::all_of(history.begin(), history.end(), [](const MultigridLevel & level) { return level.converged; }),
+              "A multigrid level did not converge");
+
+        const real tolerance = std::max<real>(1e-8, 1e4 * std::numeric_limits<storage>::epsilon());
+        check_close(drizzle.as_vector(model), expected, tolerance, "Multigrid against single-level CGLS");
+
+        // At a realistic tolerance, both stopping at 1e-6 of the normal residual of the zero model. The coarse start
+        // resolves the smooth components, but the slow ones of A^T A are high frequencies, so the finest level
+        // is no faster than CGLS from zero and the coarse iterations come on top of it
+        Cgls realistic(drizzle);
+        realistic.set_damping(damping).set_jacobi_preconditioner().set_tolerance(1e-6).set_max_iterations(1000);
+        static_cast<void>(realistic.solve(observations));
+        CascadicMultigrid cascade(model_size, exposures, 3, 2);
+        cascade.set_damping(damping).set_tolerance(1e-6).set_max_iterations(1000);
+        static_cast<void>(cascade.solve());
+        check(realistic.converged() && (cascade.history().back().iterations <= realistic.iterations()),
+              fmt::format("Finest multigrid level took {} iterations, single-level CGLS {}",
+                          cascade.history().back().iterations, realistic.iterations()));
+        check(cascade.iterations() < 2 * realistic.iterations(),
+              fmt::format("Multigrid took {} iterations in total, single-level CGLS {}",
+                          cascade.iterations(), realistic.iterations()));
+    }
+}
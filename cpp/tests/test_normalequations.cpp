@@ -0,0 +1,64 @@
+#include <limits>
+
+#include "tests/tests.h"
+#include "reconstruction/normalequations.h"
+
+namespace Astar::Tests {
+    /** Streamed normal equations must equal A^T W A and A^T W b assembled from the overlap matrices,
+     *  with the observations scaled by pixel area like the rest of the reconstruction **/
+    void test_normalequations() {
+        const pair<int> model_size = {30, 24};
+        std::vector<DetectorImage> exposures = three_exposures(Point(15, 12), model_size);
+        // First pixels of 2×2 model cells, rotated, so the footprints span three or four cells each way
+        exposures.emplace(exposures.begin(), Point(15.3, 11.6), pair<real>(24, 16), 0.3, pair<real>(1, 1), pair<int>(12, 8));
+        exposures.front().data() = Matrix::Random(8, 12);
+        std::vector<Matrix> weights;
+        for (auto && exposure: exposures) {
+            weights.push_back(Matrix::Random(exposure.height(), exposure.width()).cwiseAbs());
+        }
+
+        const int radius = NormalEquations::coupling_radius(exposures);
+        check(radius == 3, fmt::format("Coupling radius of the exposures is {}, expected 3", radius));
+
+        // Dense A^T W A and A^T W b, the first exposure with unit weights and the others weighted
+        const Eigen::Index cells = model_size.first * model_size.second;
+        RealMatrix expected_matrix = RealMatrix::Zero(cells, cells);
+        RealVector expected_rhs = RealVector::Zero(cells);
+        for (std::size_t e = 0; e < exposures.size(); ++e) {
+            const RealMatrix overlaps = RealSparseMatrix(ModelImage::overlap_matrix(model_size, exposures[e]).cast<real>()).toDense();
+            const RealVector w = (e == 0)
+                ? RealVector(RealVector::Ones(overlaps.rows()))
+                : RealVector(weights[e].reshaped<Eigen::RowMajor>().cast<real>());
+            const RealVector b = exposures[e].data().reshaped<Eigen::RowMajor>().cast<real>() * exposures[e].pixel_area(0, 0);
+            expected_matrix += overlaps.transpose() * w.asDiagonal() * overlaps;
+            expected_rhs += overlaps.transpose() * w.cwiseProduct(b);
+        }
+
+        const real tolerance = 1e3 * std::numeric_limits<storage>::epsilon();
+        for (int threads: {1, 4}) {
+            NormalEquations equations(model_size, radius, threads);
+            equations.add(exposures[0]);
+            for (std::size_t e = 1; e < exposures.size(); ++e) {
+                equations.add(exposures[e], weights[e]);
+            }
+            check(equations.exposures() == 4, "Not every exposure was counted");
+
+            const RealVector x = RealVector::Random(cells);
+            check_close(RealMatrix(equations.matrix()), expected_matrix, tolerance, fmt::format("A^T W A, {} threads", threads));
+            check_close(equations.multiply(x), expected_matrix * x, tolerance, fmt::format("A^T W A x, {} threads", threads));
+            check_close(equations.rhs(), expected_rhs, tolerance, fmt::format("A^T W b, {} threads", threads));
+            check_close(equations.diagonal(), expected_matrix.diagonal(), tolerance, fmt::format("Diagonal, {} threads", threads));
+        }
+
+        // A radius too small for the footprints must be rejected without touching the accumulated sums
+        NormalEquations small(model_size, radius - 2);
+        bool rejected = false;
+        try {
+            small.add(exposures[0]);
+        } catch (const std::invalid_argument &) {
+            rejected = true;
+        }
+        check(rejected, "Pixels wider than the coupling radius were accepted");
+        check((small.exposures() == 0) && (small.rhs().isZero()), "A rejected exposure left contributions behind");
+    }
+}
@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <fstream>
+
+#include "tests/tests.h"
+#include "grid/modelimage.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** Save a non-square image in either order, check the header and read it back in every way there is **/
+        void check_round_trip(bool fortran_order) {
+            ModelImage image(9, 4);
+            image.data() = Matrix::Random(4, 9);
+            const std::string filename = scratch(fortran_order ? "fortran.npy" : "c.npy").string();
+            image.save_npy(filename, fortran_order);
+
+            const NpyArray array(filename);
+            check(array.fortran_order() == fortran_order, fmt::format("{} has the wrong order", filename));
+            check(array.descr() == npy_descr(), fmt::format("{} is stored as {}", filename, array.descr()));
+            check((array.rows() == 4) && (array.cols() == 9),
+                  fmt::format("{} has shape ({}, {})", filename, array.rows(), array.cols()));
+            check_close(array.matrix().cast<real>(), image.data().cast<real>(), 0, fmt::format("Matrix of {}", filename));
+
+            ModelImage loaded(9, 4);
+            loaded.load_npy(filename);
+            check_close(loaded.data().cast<real>(), image.data().cast<real>(), 0, fmt::format("Image loaded from {}", filename));
+
+            if (!fortran_order) {
+                check_close(array.view().cast<real>(), image.data().cast<real>(), 0, fmt::format("View of {}", filename));
+            }
+        }
+
+        /** Another type in Fortran order, as numpy writes a transposed array, is converted while reading **/
+        void check_conversion() {
+            typedef Eigen::Matrix<std::uint16_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> Words;
+            Words words(3, 5);
+            for (Eigen::Index i = 0; i < words.size(); ++i) {
+                words.data()[i] = static_cast<std::uint16_t>(1000 * i + 7);
+            }
+            const std::string filename = scratch("u2.npy").string();
+            const std::string header = npy_header("<u2", true, words.rows(), words.cols());
+            std::ofstream out(filename, std::ios::binary);
+            out.write(header.data(), static_cast<std::streamsize>(header.size()));
+            out.write(reinterpret_cast<const char *>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(std::uint16_t)));
+            out.close();
+
+            check_close(NpyArray(filename).matrix().cast<real>(), words.cast<real>(), 0, "Fortran-ordered uint16 array");
+        }
+
+        /** Negative dimensions must be rejected even when their product looks like a valid size **/
+        void check_negative_shape() {
+            const std::string filename = scratch("negative.npy").string();
+            const std::string header = npy_header("<f8", false, -1, -1);
+            const double value = 1;
+            std::ofstream out(filename, std::ios::binary);
+            out.write(header.data(), static_cast<std::streamsize>(header.size()));
+            out.write(reinterpret_cast<const char *>(&value), sizeof value);
+            out.close();
+
+            bool rejected = false;
+            try {
+                static_cast<void>(NpyArray(filename));
+            } catch (const std::runtime_error &) {
+                rejected = true;
+            }
+            check(rejected, "Array of shape (-1, -1) was accepted");
+        }
+    }
+
+    void test_npy() {
+        check_round_trip(false);
+        check_round_trip(true);
+        check_conversion();
+        check_negative_shape();
+    }
+}
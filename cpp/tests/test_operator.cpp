@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <limits>
+
+#include "tests/tests.h"
+#include "grid/drizzleoperator.h"
+#include "utils/blocksparse.h"
+#include "reconstruction/cgls.h"
+
+namespace Astar::Tests {
+    /** The matrix-free operator must apply the same matrix as the stacked ModelImage::overlap_matrix
+     *  that the assembled and cached solvers use, both forwards and in the adjoint,
+     *  and its normal operator must work as the matrix of Eigen's conjugate gradient **/
+    void test_operator() {
+        const pair<int> model_size = {40, 30};
+        const std::vector<DetectorImage> exposures = three_exposures(Point(20, 15), model_size);
+        const ModelImage model(model_size);
+        std::vector<SparseMatrix> blocks;
+        for (auto && exposure: exposures) {
+            blocks.push_back(model.overlap_matrix(exposure));
+        }
+        const RealSparseMatrix matrix = BlockSparseMatrix(std::move(blocks)).flatten().cast<real>();
+
+        // The assembled matrix keeps its values in `storage`, the operator computes them in `real`
+        const real tolerance = 1e3 * std::numeric_limits<storage>::epsilon();
+        for (int threads: {1, 3}) {
+            const DrizzleOperator drizzle(model_size, exposures, threads);
+            check((drizzle.rows() == matrix.rows()) && (drizzle.cols() == matrix.cols()), "Operator has the wrong shape");
+
+            const RealVector x = RealVector::Random(drizzle.cols());
+            const RealVector y = RealVector::Random(drizzle.rows());
+            check_close(drizzle.forward(x), matrix * x, tolerance, fmt::format("Forward product, {} threads", threads));
+            check_close(drizzle.adjoint(y), matrix.transpose() * y, tolerance, fmt::format("Adjoint product, {} threads", threads));
+        }
+
+        // Eigen's conjugate gradient over the damped normal operator, exactly as its documentation shows,
+        // must reach the solution of the dense normal equations and of CGLS with the same damping
+        const real damping = 0.1;
+        const DrizzleOperator drizzle(model_size, exposures, 2);
+        const RealVector rhs = drizzle.adjoint(drizzle.observations());
+        const RealMatrix dense = RealMatrix(matrix.transpose() * matrix)
+            + damping * RealMatrix::Identity(matrix.cols(), matrix.cols());
+        const RealVector expected = dense.ldlt().solve(rhs);
+
+        const real solved = std::max<real>(1e-8, 1e4 * std::numeric_limits<storage>::epsilon());
+        const NormalOperator normal(drizzle, damping);
+        check_close(normal * expected, dense * expected, tolerance, "Product with the normal operator");
+        Eigen::ConjugateGradient<NormalOperator, Eigen::Lower | Eigen::Upper, Eigen::IdentityPreconditioner> cg;
+        cg.setTolerance(1e-12).setMaxIterations(1000);
+        cg.compute(normal);
+        const RealVector solution = cg.solve(rhs);
+        check(cg.info() == Eigen::Success, fmt::format("Conjugate gradient failed after {} iterations", cg.iterations()));
+        check_close(solution, expected, solved, "Conjugate gradient on the normal operator");
+
+        Cgls cgls(drizzle);
+        cgls.set_damping(damping).set_tolerance(1e-12).set_max_iterations(1000);
+        check_close(cgls.solve(drizzle.observations()), solution, solved, "Conjugate gradient against CGLS");
+    }
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+
+#include "tests/tests.h"
+#include "grid/overlapcache.h"
+
+namespace Astar::Tests {
+    namespace {
+        // Offsets in the documented file layout
+        constexpr std::size_t KernelVersionOffset = 12;
+        constexpr std::size_t KeyOffset = 40;
+        constexpr std::size_t OuterOffset = 128;
+
+        std::filesystem::path cache_file(const OverlapCache & cache, pair<int> model_size, const DetectorImage & image) {
+            return cache.directory() / fmt::format("{:016x}.csr", OverlapCache::key(model_size, image));
+        }
+
+        template<class T>
+        void overwrite(const std::filesystem::path & path, std::size_t offset, T value) {
+            std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(static_cast<std::streamoff>(offset));
+            file.write(reinterpret_cast<const char *>(&value), sizeof value);
+        }
+
+        void check_identical(const SparseMatrix & actual, const SparseMatrix & expected, const std::string & name) {
+            check((actual.rows() == expected.rows()) && (actual.cols() == expected.cols()) &&
+                  (actual.nonZeros() == expected.nonZeros()),
+                  fmt::format("{}: {}×{} with {} nonzeros, expected {}×{} with {}", name, actual.cols(), actual.rows(),
+                              actual.nonZeros(), expected.cols(), expected.rows(), expected.nonZeros()));
+            check(std::equal(expected.outerIndexPtr(), expected.outerIndexPtr() + expected.rows() + 1, actual.outerIndexPtr()) &&
+                  std::equal(expected.innerIndexPtr(), expected.innerIndexPtr() + expected.nonZeros(), actual.innerIndexPtr()) &&
+                  std::equal(expected.valuePtr(), expected.valuePtr() + expected.nonZeros(), actual.valuePtr()),
+                  fmt::format("{}: matrix differs from the computed one", name));
+        }
+
+        void set_age(const std::filesystem::path & path, int seconds) {
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now() - std::chrono::seconds(seconds));
+        }
+    }
+
+    /** Cached overlap matrices must be exactly the computed ones, corrupt or foreign files must be recomputed,
+     *  and the least recently used files must go once the cache outgrows its limit **/
+    void test_overlapcache() {
+        const std::filesystem::path directory = scratch("overlapcache");
+        std::filesystem::remove_all(directory);
+
+        const ModelImage model(pair<int>(30, 24));
+        const DetectorImage image(Point(15.2, 11.7), pair<real>(20, 16), 0.3, pair<real>(0.8, 0.8), pair<int>(14, 11));
+        const SparseMatrix expected = model.overlap_matrix(image);
+
+        // A miss computes and stores, a hit reads back the same bits
+        OverlapCache cache(directory);
+        check_identical(cache.overlap_matrix(model, image), expected, "Miss");
+        const std::filesystem::path file = cache_file(cache, model.size(), image);
+        check(std::filesystem::exists(file), "Miss did not store the matrix");
+        for (auto && entry: std::filesystem::directory_iterator(directory)) {
+            check(entry.path().extension() == ".csr", fmt::format("Storing left {} behind", entry.path().string()));
+        }
+        check_identical(cache.overlap_matrix(model, image), expected, "Hit");
+        const std::uintmax_t size = std::filesystem::file_size(file);
+        check((cache.statistics().hits == 1) && (cache.statistics().misses == 1) && (cache.statistics().evictions == 0),
+              fmt::format("{} hits and {} misses, expected one of each", cache.statistics().hits, cache.statistics().misses));
+        check((cache.statistics().bytes_written == size) && (cache.statistics().bytes_read == size),
+              fmt::format("{} bytes written and {} read, the file has {}", cache.statistics().bytes_written,
+                          cache.statistics().bytes_read, size));
+
+        // Another cache over the same directory starts warm
+        OverlapCache warm(directory);
+        check_identical(warm.overlap_matrix(model, image), expected, "Hit in a new cache");
+        check((warm.statistics().hits == 1) && (warm.statistics().misses == 0), "New cache missed a stored matrix");
+
+        // Damaged or outdated files are misses, recomputed and overwritten
+        auto check_rejected = [&](const std::string & what, auto && damage) {
+            damage();
+            OverlapCache fresh(directory);
+            check_identical(fresh.overlap_matrix(model, image), expected, what);
+            check((fresh.statistics().hits == 0) && (fresh.statistics().misses == 1), fmt::format("A file with {} was used", what));
+            check_identical(fresh.overlap_matrix(model, image), expected, fmt::format("{}, rewritten", what));
+            check(fresh.statistics().hits == 1, fmt::format("A file with {} was not replaced", what));
+        };
+        const std::size_t inner = OuterOffset + (image.count() + 1) * sizeof(std::int32_t);
+        check_rejected("a truncated end", [&] { std::filesystem::resize_file(file, size - 4); });
+        check_rejected("a truncated header", [&] { std::filesystem::resize_file(file, 100); });
+        check_rejected("a bad magic", [&] { overwrite(file, 0, 'X'); });
+        check_rejected("another kernel version", [&] { overwrite(file, KernelVersionOffset, OverlapCache::KernelVersion + 1); });
+        check_rejected("outer indices not starting at zero", [&] { overwrite(file, OuterOffset, std::int32_t {1}); });
+        check_rejected("decreasing outer indices", [&] { overwrite(file, OuterOffset + 8, std::int32_t {-5}); });
+        check_rejected("a column out of range", [&] { overwrite(file, inner, static_cast<std::int32_t>(model.count())); });
+        check_rejected("a negative column", [&] { overwrite(file, inner, std::int32_t {-1}); });
+        check_rejected("repeated columns", [&] {
+            std::int32_t first = 0;
+            std::ifstream in(file, std::ios::binary);
+            in.seekg(static_cast<std::streamoff>(inner));
+            in.read(reinterpret_cast<char *>(&first), sizeof first);
+            overwrite(file, inner + sizeof first, first);
+        });
+
+        // Another geometry is a miss even if it finds a file under its own key, as after a hash collision
+        const DetectorImage moved = image + Point(0.25, 0);
+        const std::filesystem::path collision = cache_file(cache, model.size(), moved);
+        std::filesystem::copy_file(file, collision);
+        overwrite(collision, KeyOffset, OverlapCache::key(model.size(), moved));
+        OverlapCache geometry(directory);
+        check_identical(geometry.overlap_matrix(model, moved), model.overlap_matrix(moved), "Colliding key");
+        const DetectorImage narrower(image.centre(), image.physical_size(), image.rotation(), pair<real>(0.7, 0.8), image.size());
+        check_identical(geometry.overlap_matrix(model, narrower), model.overlap_matrix(narrower), "Other pixfrac");
+        const ModelImage larger(pair<int>(32, 24));
+        check_identical(geometry.overlap_matrix(larger, image), larger.overlap_matrix(image), "Other model size");
+        check((geometry.statistics().hits == 0) && (geometry.statistics().misses == 3),
+              fmt::format("Other geometries gave {} hits", geometry.statistics().hits));
+
+        // Room for two files: the least recently used one goes, and a hit counts as a use
+        std::filesystem::remove_all(directory);
+        std::vector<DetectorImage> shifted;
+        for (int i = 0; i < 3; ++i) {
+            shifted.push_back(image + Point(i, 0));
+        }
+        OverlapCache small(directory, 5 * size / 2);
+        static_cast<void>(small.overlap_matrix(model, shifted[0]));
+        static_cast<void>(small.overlap_matrix(model, shifted[1]));
+        check(small.statistics().evictions == 0, "Evicted while below the size limit");
+        set_age(cache_file(small, model.size(), shifted[0]), 20);
+        set_age(cache_file(small, model.size(), shifted[1]), 10);
+        check_identical(small.overlap_matrix(model, shifted[0]), model.overlap_matrix(shifted[0]), "Hit before eviction");
+        static_cast<void>(small.overlap_matrix(model, shifted[2]));
+        check(small.statistics().evictions == 1, fmt::format("{} evictions, expected 1", small.statistics().evictions));
+        check(std::filesystem::exists(cache_file(small, model.size(), shifted[0])), "Recently used file was evicted");
+        check(!std::filesystem::exists(cache_file(small, model.size(), shifted[1])), "Least recently used file was kept");
+        check(std::filesystem::exists(cache_file(small, model.size(), shifted[2])), "New file was evicted");
+        check((small.statistics().hits == 1) && (small.statistics().misses == 3),
+              fmt::format("{} hits and {} misses, expected 1 and 3", small.statistics().hits, small.statistics().misses));
+    }
+}
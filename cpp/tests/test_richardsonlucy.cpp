@@ -0,0 +1,39 @@
+#include "tests/tests.h"
+#include "reconstruction/richardsonlucy.h"
+
+namespace Astar::Tests {
+    /** Richardson–Lucy must keep the model non-negative, with or without acceleration, and without it
+     *  every iteration is an EM step, which never increases the Poisson deviance **/
+    void test_richardsonlucy() {
+        const pair<int> model_size = {24, 18};
+        const std::vector<DetectorImage> exposures = three_exposures(Point(12, 9), model_size);
+        const DrizzleOperator drizzle(model_size, exposures, 2);
+
+        // Counts of a positive scene with a few dark cells, so that the model is pushed towards zero there
+        RealVector truth = (RealVector::Random(drizzle.cols()).array() + 1.2).matrix() * 50;
+        for (Eigen::Index c = 0; c < truth.size(); c += 7) {
+            truth[c] = 0;
+        }
+        const RealVector observations = drizzle.forward(truth);
+
+        for (bool accelerated: {false, true}) {
+            const std::string name = accelerated ? "accelerated" : "plain";
+            RichardsonLucy solver(drizzle);
+            solver.set_acceleration(accelerated).set_tolerance(1e-12).set_max_iterations(60);
+            const RealVector x = solver.solve(observations);
+
+            check(x.allFinite() && (x.minCoeff() >= 0), fmt::format("{}: model went negative, {}", name, x.minCoeff()));
+            const auto & history = solver.history();
+            check(history.back().deviance < 0.01 * history.front().deviance,
+                  fmt::format("{}: deviance fell only from {} to {}", name, history.front().deviance, history.back().deviance));
+            if (!accelerated) {
+                for (std::size_t k = 1; k < history.size(); ++k) {
+                    check(history[k].deviance <= history[k - 1].deviance * (1 + 1e-12),
+                          fmt::format("Deviance rose from {} to {} at iteration {}",
+                                      history[k - 1].deviance, history[k].deviance, history[k].iteration));
+                    check(history[k].acceleration == 0, "Plain iterations were extrapolated");
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <limits>
+
+#include "tests/tests.h"
+#include "grid/modelimage.h"
+#include "grid/stencilmatrix.h"
+#include "utils/blocksparse.h"
+
+namespace Astar::Tests {
+    namespace {
+        /** Stencils must apply the same matrix as the stacked ModelImage::overlap_matrix, forwards and transposed **/
+        void check_products(const std::string & name, pair<int> model_size, const std::vector<DetectorImage> & exposures,
+                            const StencilMatrix & stencils) {
+            std::vector<SparseMatrix> blocks;
+            for (auto && exposure: exposures) {
+                blocks.push_back(ModelImage::overlap_matrix(model_size, exposure));
+            }
+            const RealSparseMatrix matrix = BlockSparseMatrix(std::move(blocks)).flatten().cast<real>();
+            check((stencils.rows() == matrix.rows()) && (stencils.cols() == matrix.cols()),
+                  fmt::format("{}: stencils have the wrong shape", name));
+            check(stencils.nonzeros() == static_cast<std::size_t>(matrix.nonZeros()),
+                  fmt::format("{}: {} nonzeros, expected {}", name, stencils.nonzeros(), matrix.nonZeros()));
+
+            const real tolerance = 1e3 * std::numeric_limits<storage>::epsilon();
+            const RealVector x = RealVector::Random(stencils.cols());
+            const RealVector y = RealVector::Random(stencils.rows());
+            check_close(stencils.multiply(x), matrix * x, tolerance, fmt::format("{}: forward product", name));
+            check_close(stencils.multiply_transposed(y), matrix.transpose() * y, tolerance,
+                        fmt::format("{}: transposed product", name));
+        }
+    }
+
+    void test_stencils() {
+        const pair<int> model_size = {32, 28};
+
+        // Aligned, so the weights are separable and there are no patterns at all
+        const std::vector<DetectorImage> aligned {
+            DetectorImage(Point(16.3, 13.8), pair<real>(26, 21), 0, pair<real>(0.7, 0.9), pair<int>(19, 15))
+        };
+        const StencilMatrix separable(model_size, aligned);
+        check_products("aligned", model_size, aligned, separable);
+        check(separable.pattern_count() == 0, fmt::format("Aligned exposure has {} patterns", separable.pattern_count()));
+        check(separable.bytes() < separable.explicit_bytes(), "Separable weights are larger than the explicit matrix");
+
+        // Rotated by a Pythagorean angle with unit pixels, so the lattice repeats every five pixels in both directions
+        const std::vector<DetectorImage> commensurate {
+            DetectorImage(Point(16, 14), pair<real>(15, 15), std::atan2(0.8, 0.6), pair<real>(1, 1), pair<int>(15, 15))
+        };
+        const StencilMatrix repeating(model_size, commensurate);
+        check_products("commensurate", model_size, commensurate, repeating);
+        check(4 * repeating.pattern_count() < static_cast<std::size_t>(repeating.rows()),
+              fmt::format("Commensurate lattice has {} patterns for {} pixels", repeating.pattern_count(), repeating.rows()));
+        check(repeating.bytes() < repeating.explicit_bytes(), "Repeating patterns are larger than the explicit matrix");
+
+        // A generic rotation gives almost every pixel a pattern of its own, so the exposure is kept as explicit rows
+        const std::vector<DetectorImage> generic {
+            DetectorImage(Point(15.7, 14.2), pair<real>(18, 14), 0.3, pair<real>(0.8, 0.8), pair<int>(16, 12))
+        };
+        const StencilMatrix unique(model_size, generic);
+        check_products("generic", model_size, generic, unique);
+        check(unique.pattern_count() == 0, fmt::format("Generic rotation kept {} patterns", unique.pattern_count()));
+
+        // All of them together, over several threads
+        std::vector<DetectorImage> all = aligned;
+        all.insert(all.end(), commensurate.begin(), commensurate.end());
+        all.insert(all.end(), generic.begin(), generic.end());
+        const StencilMatrix mixed(model_size, all, 1e-12, 3);
+        check_products("mixed", model_size, all, mixed);
+        check(mixed.pattern_count() == repeating.pattern_count(), "Mixed exposures do not keep the commensurate patterns");
+        check(mixed.bytes() < mixed.explicit_bytes(),
+              fmt::format("Stencils take {} bytes, the explicit matrix {}", mixed.bytes(), mixed.explicit_bytes()));
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef ANASTASIS_CPP_TESTS_H
+#define ANASTASIS_CPP_TESTS_H
+
+#include <filesystem>
+#include <string>
+
+#include "types/types.h"
+#include "utils/eigen.h"
+#include "grid/detectorimage.h"
+
+namespace Astar::Tests {
+    /** Throw with the message unless the condition holds **/
+    void check(bool condition, const std::string & message);
+    /** Throw unless the matrices have the same shape and differ by at most `tolerance` anywhere **/
+    void check_close(const RealMatrix & actual, const RealMatrix & expected, real tolerance, const std::string & message);
+    /** Path of a scratch file in a directory of its own under the system temporary directory **/
+    std::filesystem::path scratch(const std::string & name);
+    /** Three exposures of random data around `centre`, sized after a model of `model_size`: one rotated by 0.3 rad
+     *  with pixfrac 0.8, one axis-aligned with pixfrac 0.7 and one at Tau / 8 with pixfrac 1, all with different
+     *  pixels between 1.2 and 1.4 model cells, so that they overlap each other and most of the model **/
+    std::vector<DetectorImage> three_exposures(Point centre, pair<int> model_size);
+
+    void test_bitmap();
+    void test_cgls();
+    void test_choleskyfactor();
+    void test_drizzle();
+    void test_exposureloader();
+    void test_fits();
+    void test_interlacing();
+    void test_kernels();
+    void test_manifest();
+    void test_multigrid();
+    void test_normalequations();
+    void test_npy();
+    void test_operator();
+    void test_overlapcache();
+    void test_richardsonlucy();
+    void test_stencils();
+}
+
+#endif //ANASTASIS_CPP_TESTS_H
@@ -6,11 +6,17 @@
 
 typedef double real;
 
+// Images and matrices are stored in `storage`, which is single precision if built with ANASTASIS_FLOAT_STORAGE.
+// Geometry, sums and reductions are always computed in `real`.
+#ifdef ANASTASIS_FLOAT_STORAGE
+typedef float storage;
+#else
+typedef double storage;
+#endif
+
 template<class T>
 using pair = std::pair<T, T>;
 
-typedef std::tuple<long, long, long, long, real> Overlap4D;
-
 // Simply tau = 2 * pi
 constexpr real Tau = 3.14159265358979232846264 * 2.0;
 constexpr real TauFourth = Tau * 0.25;
@@ -0,0 +1,118 @@
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#include "utils/bitmap.h"
+#include "utils/eigen.h"
+
+namespace Astar {
+    namespace {
+        constexpr unsigned int Uncompressed = 0;
+        constexpr unsigned int BitFields = 3;
+
+        /** Mean of the three masked channels of a row of little-endian 16- or 32-bit pixels, scaled to [0, 1] **/
+        template<class Word, class Channels>
+        Eigen::Array<real, Eigen::Dynamic, 1> masked_sum(const unsigned char * source, int width, const Channels & channels) {
+            // Rows need not be aligned for Word, so copy them out of the file before reading them as words
+            Eigen::Array<Word, Eigen::Dynamic, 1> pixels(width);
+            std::memcpy(pixels.data(), source, static_cast<std::size_t>(width) * sizeof(Word));
+            Eigen::Array<real, Eigen::Dynamic, 1> sum = Eigen::Array<real, Eigen::Dynamic, 1>::Zero(width);
+            for (auto && channel: channels) {
+                const Word mask = static_cast<Word>(channel.mask);
+                const int shift = channel.shift;
+                sum += pixels.unaryExpr([mask, shift](Word pixel) { return static_cast<Word>((pixel & mask) >> shift); })
+                             .template cast<real>() * channel.scale;
+            }
+            return sum / 3.0;
+        }
+    }
+
+    Bitmap::Bitmap(const std::string & filename):
+        file_(filename)
+    {
+        const BITMAPHEADER & header = *this->file_.view<BITMAPHEADER>(0);
+        if (header.biHeader != 0x4D42) {
+            throw std::runtime_error(fmt::format("Invalid BMP magic value {:04x}", header.biHeader));
+        }
+        const BITMAPINFOHEADER & info = *this->file_.view<BITMAPINFOHEADER>(sizeof(BITMAPHEADER));
+        if (info.biPlanes != 1) {
+            throw std::runtime_error(fmt::format("Invalid number of image planes {}, must be 1", info.biPlanes));
+        }
+
+        this->bits_ = info.biBitCount;
+        if ((this->bits_ != 8) && (this->bits_ != 16) && (this->bits_ != 24) && (this->bits_ != 32)) {
+            throw std::runtime_error(fmt::format("Unsupported BPP {}, must be 8, 16, 24 or 32", this->bits_));
+        }
+        const bool masked = (info.biCompression == BitFields) && ((this->bits_ == 16) || (this->bits_ == 32));
+        if ((info.biCompression != Uncompressed) && !masked) {
+            throw std::runtime_error(fmt::format("Unsupported BMP compression {}", info.biCompression));
+        }
+
+        // The sign of the height is the row order, so its absolute value must exist and be positive
+        if ((info.biHeight == 0) || (info.biHeight == std::numeric_limits<decltype(info.biHeight)>::min())) {
+            throw std::runtime_error(fmt::format("Invalid BMP height {}", info.biHeight));
+        }
+        this->width_ = info.biWidth;
+        this->height_ = std::abs(info.biHeight);
+        this->top_down_ = info.biHeight < 0;
+        if (this->width_ <= 0) {
+            throw std::runtime_error(fmt::format("Invalid BMP width {}", this->width_));
+        }
+
+        // Channel masks default to 5-5-5 for 16 bits and 8-8-8 for 32 bits, unless given right after the header
+        std::uint32_t masks[3] = {0x7C00, 0x03E0, 0x001F};
+        if (this->bits_ == 32) {
+            masks[0] = 0x00FF0000;
+            masks[1] = 0x0000FF00;
+            masks[2] = 0x000000FF;
+        }
+        if (masked) {
+            std::memcpy(masks, this->file_.view<std::uint32_t>(sizeof(BITMAPHEADER) + 40, 3), sizeof masks);
+        }
+        for (int c = 0; c < 3; ++c) {
+            if (masks[c] == 0) {
+                throw std::runtime_error(fmt::format("Empty colour mask in BMP file {}", filename));
+            }
+            const int shift = std::countr_zero(masks[c]);
+            this->channels_[c] = {masks[c], shift, 1.0 / static_cast<real>(masks[c] >> shift)};
+        }
+
+        this->offset_ = header.biOffset;
+        this->stride_ = (static_cast<std::size_t>(this->width_) * this->bits_ + 31) / 32 * 4;
+        // Only to check that the whole pixel array is present
+        static_cast<void>(this->file_.view<unsigned char>(this->offset_, this->stride_ * this->height_));
+    }
+
+    void Bitmap::convert_row(const unsigned char * source, storage * target) const {
+        typedef Eigen::Array<unsigned char, Eigen::Dynamic, 1> Bytes;
+        typedef Eigen::Array<storage, Eigen::Dynamic, 1> Values;
+        Eigen::Map<Values> out(target, this->width_);
+
+        switch (this->bits_) {
+            case 8:
+                out = (Eigen::Map<const Bytes>(source, this->width_).cast<real>() / 255.0).cast<storage>();
+                break;
+            case 24: {
+                // Channels are interleaved as BGR, sum them with a stride of three bytes
+                typedef Eigen::Map<const Bytes, 0, Eigen::InnerStride<3>> Channel;
+                out = ((Channel(source, this->width_).cast<real>() + Channel(source + 1, this->width_).cast<real>() +
+                        Channel(source + 2, this->width_).cast<real>()) / (3.0 * 255.0)).cast<storage>();
+                break;
+            }
+            case 16:
+                out = masked_sum<std::uint16_t>(source, this->width_, this->channels_).cast<storage>();
+                break;
+            default:
+                out = masked_sum<std::uint32_t>(source, this->width_, this->channels_).cast<storage>();
+        }
+    }
+
+    void Bitmap::convert(storage * target) const {
+        const auto * pixels = reinterpret_cast<const unsigned char *>(this->file_.data()) + this->offset_;
+        for (int row = 0; row < this->height_; ++row) {
+            // Rows are stored bottom-up unless the height is negative
+            const int source = this->top_down_ ? this->height_ - 1 - row : row;
+            this->convert_row(pixels + this->stride_ * source, target + static_cast<std::size_t>(this->width_) * row);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ANASTASIS_CPP_BITMAP_H
+#define ANASTASIS_CPP_BITMAP_H
+
+#include <cstdint>
+
+#include "types/types.h"
+#include "utils/mappedfile.h"
+
+#pragma pack(push,2)
+typedef struct tagBITMAPHEADER {
+    unsigned short  biHeader = 0x4D42;
+    unsigned int    biSize = 0;
+    unsigned short  biReservedCrap1 = 0;
+    unsigned short  biReservedCrap2 = 0;
+    unsigned int    biOffset = 1078;
+} BITMAPHEADER;
+
+typedef struct tagBITMAPINFOHEADER {
+    unsigned int    biSize = 40;
+    int             biWidth = 0;
+    int             biHeight = 0;
+    short           biPlanes = 1;
+    short           biBitCount = 8;
+    unsigned int    biCompression = 0;
+    unsigned int    biSizeImage = 0;
+    int             biXPelsPerMeter = 2835;
+    int             biYPelsPerMeter = 2835;
+    unsigned int    biClrUsed = 0;
+    unsigned int    biClrImportant = 0;
+} BITMAPINFOHEADER;
+#pragma pack(pop)
+
+namespace Astar {
+    /** Memory-mapped BMP file, with the header parsed and validated once on opening.
+     *
+     *  Supports uncompressed 8, 16, 24 and 32 bits per pixel (and bit field masks for 16 and 32),
+     *  rows padded to 4 bytes, and both bottom-up and top-down (negative height) row order.
+     *  Pixels are converted to intensities in [0, 1]: 8-bit values are taken as grey levels, ignoring the palette,
+     *  colour pixels are the mean of their red, green and blue channels.
+     */
+    class Bitmap {
+    private:
+        struct Channel {
+            std::uint32_t mask;
+            int shift;
+            real scale;             // 1 / maximum value of the channel
+        };
+
+        MappedFile file_;
+        int width_;
+        int height_;
+        int bits_;
+        bool top_down_;
+        std::size_t offset_;        // Start of the pixel array
+        std::size_t stride_;        // Bytes per row, including the padding
+        Channel channels_[3];       // Red, green, blue for 16 and 32 bits per pixel
+
+        void convert_row(const unsigned char * source, storage * target) const;
+    public:
+        explicit Bitmap(const std::string & filename);
+
+        [[nodiscard]] const std::string & filename() const { return this->file_.filename(); }
+        [[nodiscard]] int width() const { return this->width_; }
+        [[nodiscard]] int height() const { return this->height_; }
+        [[nodiscard]] pair<int> size() const { return {this->width_, this->height_}; }
+        [[nodiscard]] int bits_per_pixel() const { return this->bits_; }
+
+        /** Convert all pixels into a row-major buffer of width × height values, bottom row first **/
+        void convert(storage * target) const;
+    };
+}
+
+#endif //ANASTASIS_CPP_BITMAP_H
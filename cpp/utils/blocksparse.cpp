@@ -0,0 +1,89 @@
+#include "blocksparse.h"
+
+namespace Astar {
+    BlockSparseMatrix::BlockSparseMatrix(std::vector<SparseMatrix> blocks, bool vertical):
+        blocks_(std::move(blocks)),
+        offsets_(1, 0),
+        vertical_(vertical)
+    {
+        for (auto && block: this->blocks_) {
+            const Eigen::Index across = vertical ? block.cols() : block.rows();
+            if ((this->offsets_.size() > 1) && (across != this->across_)) {
+                throw std::invalid_argument(fmt::format("Block size {} does not match the previous blocks ({})",
+                                                        across, this->across_));
+            }
+            this->across_ = across;
+            this->offsets_.push_back(this->offsets_.back() + (vertical ? block.rows() : block.cols()));
+        }
+    }
+
+    Eigen::Index BlockSparseMatrix::nonZeros() const {
+        Eigen::Index nonzeros = 0;
+        for (auto && block: this->blocks_) {
+            nonzeros += block.nonZeros();
+        }
+        return nonzeros;
+    }
+
+    RealVector BlockSparseMatrix::multiply(const RealVector & x) const {
+        if (x.size() != this->cols()) {
+            throw std::invalid_argument(fmt::format("Vector of size {} cannot multiply a matrix with {} columns",
+                                                    x.size(), this->cols()));
+        }
+
+        // Cast once, every block then reads its slice of the copy
+        const Eigen::Matrix<storage, Eigen::Dynamic, 1> values = x.cast<storage>();
+        RealVector out = RealVector::Zero(this->rows());
+        for (std::size_t b = 0; b < this->blocks_.size(); ++b) {
+            const SparseMatrix & block = this->blocks_[b];
+            if (this->vertical_) {
+                out.segment(this->offsets_[b], block.rows()) = (block * values).cast<real>();
+            } else {
+                out += (block * values.segment(this->offsets_[b], block.cols())).cast<real>();
+            }
+        }
+        return out;
+    }
+
+    RealVector BlockSparseMatrix::multiply_transposed(const RealVector & y) const {
+        if (y.size() != this->rows()) {
+            throw std::invalid_argument(fmt::format("Vector of size {} cannot multiply a transposed matrix with {} rows",
+                                                    y.size(), this->rows()));
+        }
+
+        const Eigen::Matrix<storage, Eigen::Dynamic, 1> values = y.cast<storage>();
+        RealVector out = RealVector::Zero(this->cols());
+        for (std::size_t b = 0; b < this->blocks_.size(); ++b) {
+            const SparseMatrix & block = this->blocks_[b];
+            if (this->vertical_) {
+                out += (block.transpose() * values.segment(this->offsets_[b], block.rows())).cast<real>();
+            } else {
+                out.segment(this->offsets_[b], block.cols()) = (block.transpose() * values).cast<real>();
+            }
+        }
+        return out;
+    }
+
+    RealMatrix BlockSparseMatrix::multiply_transposed(const RealMatrix & y) const {
+        if (y.rows() != this->rows()) {
+            throw std::invalid_argument(fmt::format("Matrix with {} rows cannot multiply a transposed matrix with {} rows",
+                                                    y.rows(), this->rows()));
+        }
+
+        const Matrix values = y.cast<storage>();
+        RealMatrix out = RealMatrix::Zero(this->cols(), y.cols());
+        for (std::size_t b = 0; b < this->blocks_.size(); ++b) {
+            const SparseMatrix & block = this->blocks_[b];
+            if (this->vertical_) {
+                out += (block.transpose() * values.middleRows(this->offsets_[b], block.rows())).cast<real>();
+            } else {
+                out.middleRows(this->offsets_[b], block.cols()) = (block.transpose() * values).cast<real>();
+            }
+        }
+        return out;
+    }
+
+    SparseMatrix BlockSparseMatrix::flatten() const {
+        return stack(this->blocks_, this->vertical_);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef ANASTASIS_CPP_BLOCKSPARSE_H
+#define ANASTASIS_CPP_BLOCKSPARSE_H
+
+#include <vector>
+
+#include "utils/eigen.h"
+
+namespace Astar {
+    /** A sparse matrix made of sparse blocks stacked along one axis, typically one block per exposure.
+     *  The blocks are kept as they are instead of being copied into a single big matrix,
+     *  and products are evaluated block by block.
+     */
+    class BlockSparseMatrix {
+    private:
+        std::vector<SparseMatrix> blocks_;
+        std::vector<Eigen::Index> offsets_;     // Starting row (vertical) or column (horizontal) of every block
+        Eigen::Index across_ = 0;
+        bool vertical_;
+    public:
+        explicit BlockSparseMatrix(std::vector<SparseMatrix> blocks, bool vertical = true);
+
+        [[nodiscard]] Eigen::Index rows() const { return this->vertical_ ? this->offsets_.back() : this->across_; }
+        [[nodiscard]] Eigen::Index cols() const { return this->vertical_ ? this->across_ : this->offsets_.back(); }
+        [[nodiscard]] Eigen::Index nonZeros() const;
+        [[nodiscard]] bool vertical() const { return this->vertical_; }
+
+        [[nodiscard]] std::size_t block_count() const { return this->blocks_.size(); }
+        [[nodiscard]] const SparseMatrix & block(std::size_t index) const { return this->blocks_[index]; }
+        [[nodiscard]] Eigen::Index offset(std::size_t index) const { return this->offsets_[index]; }
+
+        /** A * x **/
+        [[nodiscard]] RealVector multiply(const RealVector & x) const;
+        /** A^T * y **/
+        [[nodiscard]] RealVector multiply_transposed(const RealVector & y) const;
+        /** A^T * Y for many vectors at once, one per column **/
+        [[nodiscard]] RealMatrix multiply_transposed(const RealMatrix & y) const;
+
+        /** Copy all blocks into a single flat matrix, only if it is really needed **/
+        [[nodiscard]] SparseMatrix flatten() const;
+    };
+}
+
+#endif //ANASTASIS_CPP_BLOCKSPARSE_H
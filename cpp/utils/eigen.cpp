@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <limits>
+
 #include "utils/eigen.h"
 
 namespace Astar {
@@ -18,48 +21,74 @@ namespace Astar {
     SparseMatrix stack(const std::vector<SparseMatrix> & matrices, bool vertical) {
         /** Stack a vector of sparse matrices, either vertically or horizontally, and produce a big sparse matrix.
          *  The other (across) dimension must always match, the other one need not be equal.
+         *  Works directly on the compressed row-major storage: stacking vertically just appends the rows,
+         *  stacking horizontally appends the (shifted) columns of every row, so nothing needs to be sorted.
          */
-        long across = 0;
-        long along = 0;
-        long nonzeroes = 0;
+        Eigen::Index across = 0;
+        Eigen::Index along = 0;
+        Eigen::Index nonzeroes = 0;
         for (auto && matrix: matrices) {
-            const long num_along = vertical ? matrix.rows() : matrix.cols();
-            const long num_across = vertical ? matrix.cols() : matrix.rows();
-            if (along > 0) {
-                assert((num_across == across) && "Across-concatenation dimensions do not match");
+            const Eigen::Index num_along = vertical ? matrix.rows() : matrix.cols();
+            const Eigen::Index num_across = vertical ? matrix.cols() : matrix.rows();
+            if ((along > 0) && (num_across != across)) {
+                throw std::invalid_argument(fmt::format("Across-concatenation dimensions do not match: {} != {}",
+                                                        num_across, across));
             }
             across = num_across;
             along += num_along;
             nonzeroes += matrix.nonZeros();
         }
 
-        // fmt::print("Joining {} matrices along {} axis\n", matrices.size(), vertical ? "vertical" : "horizontal");
-        std::vector<Eigen::Triplet<real>> triplets;
-        triplets.reserve(nonzeroes);
+        const Eigen::Index rows = vertical ? along : across;
+        const Eigen::Index cols = vertical ? across : along;
+        // Positions and column indices are stored as int
+        if (nonzeroes > std::numeric_limits<int>::max()) {
+            throw std::runtime_error(fmt::format("Stacked matrix with {} nonzeros does not fit 32-bit indices", nonzeroes));
+        }
+        if (cols > std::numeric_limits<int>::max()) {
+            throw std::runtime_error(fmt::format("Stacked matrix with {} columns does not fit 32-bit indices", cols));
+        }
+        SparseMatrix m(rows, cols);
+        m.resizeNonZeros(nonzeroes);
+        int * const outer = m.outerIndexPtr();
+        int * const inner = m.innerIndexPtr();
+        storage * const values = m.valuePtr();
+
+        // Row r of a possibly uncompressed matrix occupies [start(r), start(r) + size(r)) of its arrays
+        auto start = [](const SparseMatrix & matrix, Eigen::Index r) { return matrix.outerIndexPtr()[r]; };
+        auto size = [](const SparseMatrix & matrix, Eigen::Index r) {
+            return matrix.isCompressed() ? matrix.outerIndexPtr()[r + 1] - matrix.outerIndexPtr()[r]
+                                         : matrix.innerNonZeroPtr()[r];
+        };
 
-        // Just concatenate the triplets over all matrices
-        Eigen::Index base = 0;
-        for (auto && matrix: matrices) {
-            for (Eigen::Index c = 0; c < matrix.outerSize(); ++c) {
-                for (SparseMatrix::InnerIterator it(matrix, c); it; ++it) {
-                    triplets.emplace_back(
-                            vertical ? it.row() + base : it.row(),
-                            vertical ? it.col() : base + it.col(),
-                            it.value()
-                    );
+        Eigen::Index position = 0;
+        if (vertical) {
+            Eigen::Index base = 0;
+            for (auto && matrix: matrices) {
+                for (Eigen::Index r = 0; r < matrix.rows(); ++r) {
+                    outer[base + r] = static_cast<int>(position);
+                    std::copy_n(matrix.innerIndexPtr() + start(matrix, r), size(matrix, r), inner + position);
+                    std::copy_n(matrix.valuePtr() + start(matrix, r), size(matrix, r), values + position);
+                    position += size(matrix, r);
+                }
+                base += matrix.rows();
+            }
+        } else {
+            for (Eigen::Index r = 0; r < rows; ++r) {
+                outer[r] = static_cast<int>(position);
+                int base = 0;
+                for (auto && matrix: matrices) {
+                    const int * first = matrix.innerIndexPtr() + start(matrix, r);
+                    std::transform(first, first + size(matrix, r), inner + position, [=](int c) { return c + base; });
+                    std::copy_n(matrix.valuePtr() + start(matrix, r), size(matrix, r), values + position);
+                    position += size(matrix, r);
+                    base += static_cast<int>(matrix.cols());
                 }
             }
-            base += vertical ? matrix.rows() : matrix.cols();
         }
+        outer[rows] = static_cast<int>(position);
 
-        long cols = vertical ? across : along;
-        long rows = vertical ? along : across;
-
-        SparseMatrix m(rows, cols);
-        m.reserve(nonzeroes);
-        fmt::print("After stacking: {}×{} matrix with {} nonzero elements\n", cols, rows, nonzeroes);
-
-        m.setFromTriplets(triplets.begin(), triplets.end());
+        fmt::print("After stacking: {}×{} matrix with {} nonzero elements\n", rows, cols, nonzeroes);
         return m;
     }
 
@@ -70,39 +99,4 @@ namespace Astar {
     SparseMatrix hstack(const std::vector<SparseMatrix> & matrices) {
         return stack(matrices, false);
     }
-
-
-    SparseMatrix vstack2(std::vector<SparseMatrix> matrices) {
-        long rows = 0;
-        long cols = 0;
-        long nonzeros = 0;
-        for (auto & matrix: matrices) {
-            if ((rows > 0) && (matrix.cols() != cols)) {
-                throw std::runtime_error("Sparse matrix width does not match");
-            }
-            cols = matrix.cols();
-            rows += matrix.rows();
-            nonzeros += matrix.nonZeros();
-        }
-
-        SparseMatrix m(rows, cols);
-        m.reserve(nonzeros);
-        fmt::print("{} {}\n", cols, nonzeros);
-
-        for (Eigen::Index c = 0; c < cols; ++c) {
-            Eigen::Index base = 0;
-            for (auto && matrix: matrices) {
-                m.startVec(c);
-                for (SparseMatrix::InnerIterator it(matrix, c); it; ++it) {
-                    matrix.startVec(c);
-                    // fmt::print("s {} {}\n", it, c);
-                    m.insertBack(base + it.row(), c) = it.value();
-                    // fmt::print("e {} {}\n", it, c);
-                }
-                base += matrix.rows();
-            }
-        }
-        m.finalize();
-        return m;
-    }
 }
\ No newline at end of file
@@ -6,9 +6,16 @@
 
 namespace Astar {
     typedef Eigen::Matrix<real, 2, 2> Matrix2D;
-    typedef Eigen::Matrix<real, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+    // Images are indexed as (row, col) and always traversed row by row, so store them row-major
+    typedef Eigen::Matrix<storage, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Matrix;
     typedef Eigen::Transform<real, 2, Eigen::AffineCompact> AffineTransform;
-    typedef Eigen::SparseMatrix<real> SparseMatrix;
+    // Overlap matrices are assembled and multiplied row by row (one row per detector pixel)
+    typedef Eigen::SparseMatrix<storage, Eigen::RowMajor, int> SparseMatrix;
+
+    // Full precision counterparts, for accumulating sums of stored values
+    typedef Eigen::Matrix<real, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RealMatrix;
+    typedef Eigen::SparseMatrix<real> RealSparseMatrix;
+    typedef Eigen::Matrix<real, Eigen::Dynamic, 1> RealVector;
 
     Matrix2D rotation_matrix(real rotation);
     Matrix2D scaling_matrix(pair<real> scale);
@@ -16,7 +23,6 @@ namespace Astar {
     SparseMatrix stack(const std::vector<SparseMatrix> & matrices, bool vertical);
     SparseMatrix vstack(const std::vector<SparseMatrix> & matrices);
     SparseMatrix hstack(const std::vector<SparseMatrix> & matrices);
-    SparseMatrix vstack2(std::vector<SparseMatrix> matrices);
 }
 
 #endif //ANASTASIS_CPP_EIGEN_H
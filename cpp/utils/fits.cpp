@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numbers>
+
+#include "utils/fits.h"
+
+namespace Astar {
+    namespace {
+        /** Unsigned integer of the same size as T, for swapping bytes **/
+        template<class T>
+        using Word = std::conditional_t<sizeof(T) == 8, std::uint64_t,
+                     std::conditional_t<sizeof(T) == 4, std::uint32_t,
+                     std::conditional_t<sizeof(T) == 2, std::uint16_t, std::uint8_t>>>;
+
+        template<class T>
+        inline T big_endian(const char * bytes) {
+            Word<T> word;
+            std::memcpy(&word, bytes, sizeof word);
+            if constexpr ((std::endian::native == std::endian::little) && (sizeof(T) > 1)) {
+                word = std::byteswap(word);
+            }
+            return std::bit_cast<T>(word);
+        }
+
+        /** Swap every value of the buffer between big-endian and native order **/
+        template<class T>
+        void swap_in_place(T * data, std::size_t count) {
+            if constexpr ((std::endian::native == std::endian::little) && (sizeof(T) > 1)) {
+                auto * words = reinterpret_cast<Word<T> *>(data);
+                for (std::size_t i = 0; i < count; ++i) {
+                    words[i] = std::byteswap(words[i]);
+                }
+            }
+        }
+
+        std::string trim(const std::string & text) {
+            const std::size_t begin = text.find_first_not_of(' ');
+            if (begin == std::string::npos) {
+                return "";
+            }
+            return text.substr(begin, text.find_last_not_of(' ') - begin + 1);
+        }
+
+        /** Value of a card without its comment; strings are unquoted, with doubled quotes and trailing spaces removed **/
+        std::string card_value(const std::string & field) {
+            const std::string value = trim(field);
+            if (value.empty() || (value[0] != '\'')) {
+                return trim(value.substr(0, value.find('/')));
+            }
+
+            std::string text;
+            for (std::size_t i = 1; i < value.size(); ++i) {
+                if (value[i] == '\'') {
+                    if ((i + 1 < value.size()) && (value[i + 1] == '\'')) {
+                        text.push_back('\'');
+                        ++i;
+                    } else {
+                        break;
+                    }
+                } else {
+                    text.push_back(value[i]);
+                }
+            }
+            return text.substr(0, text.find_last_not_of(' ') + 1);
+        }
+
+        bool is_latitude(const std::string & ctype) {
+            return ctype.starts_with("DEC-") || ((ctype.size() >= 4) && (ctype.substr(1, 3) == "LAT"));
+        }
+    }
+
+    void FitsHeader::set(const std::string & keyword, const std::string & value) {
+        this->values_[keyword] = value;
+    }
+
+    bool FitsHeader::has(const std::string & keyword) const {
+        return this->values_.contains(keyword);
+    }
+
+    const std::string & FitsHeader::text(const std::string & keyword) const {
+        const auto found = this->values_.find(keyword);
+        if (found == this->values_.end()) {
+            throw std::runtime_error(fmt::format("Missing FITS keyword {}", keyword));
+        }
+        return found->second;
+    }
+
+    real FitsHeader::number(const std::string & keyword) const {
+        // Fortran exponents are allowed as well
+        std::string value = this->text(keyword);
+        std::replace(value.begin(), value.end(), 'D', 'E');
+        try {
+            return std::stod(value);
+        } catch (const std::logic_error &) {
+            throw std::runtime_error(fmt::format("FITS keyword {} is not a number: '{}'", keyword, value));
+        }
+    }
+
+    real FitsHeader::number(const std::string & keyword, real fallback) const {
+        return this->has(keyword) ? this->number(keyword) : fallback;
+    }
+
+    long long FitsHeader::integer(const std::string & keyword) const {
+        const std::string & value = this->text(keyword);
+        try {
+            return std::stoll(value);
+        } catch (const std::logic_error &) {
+            throw std::runtime_error(fmt::format("FITS keyword {} is not an integer: '{}'", keyword, value));
+        }
+    }
+
+    long long FitsHeader::integer(const std::string & keyword, long long fallback) const {
+        return this->has(keyword) ? this->integer(keyword) : fallback;
+    }
+
+    bool FitsHdu::is_image() const {
+        const bool primary = this->header.has("SIMPLE");
+        const bool extension = this->header.has("XTENSION") && (this->header.text("XTENSION") == "IMAGE");
+        const long long axes = this->header.integer("NAXIS");
+        if ((!primary && !extension) || (axes < 1)) {
+            return false;
+        }
+        for (long long axis = 3; axis <= axes; ++axis) {
+            if (this->header.integer(fmt::format("NAXIS{}", axis)) != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    FitsFile::FitsFile(const std::string & filename):
+        file_(filename)
+    {
+        std::size_t offset = 0;
+        while (offset + BlockSize <= this->file_.size()) {
+            FitsHdu hdu;
+            bool ended = false;
+            for (std::size_t card = 0; !ended; ++card) {
+                const std::string text(this->file_.view<char>(offset + card * CardSize, CardSize), CardSize);
+                if ((card == 0) && !text.starts_with(this->hdus_.empty() ? "SIMPLE  " : "XTENSION")) {
+                    if (this->hdus_.empty()) {
+                        throw std::runtime_error(fmt::format("{} is not a FITS file", filename));
+                    }
+                    // Anything after the last extension is ignored
+                    return;
+                }
+
+                const std::string keyword = trim(text.substr(0, 8));
+                if (keyword == "END") {
+                    ended = true;
+                    offset += (card * CardSize / BlockSize + 1) * BlockSize;
+                } else if (text.substr(8, 2) == "= ") {
+                    hdu.header.set(keyword, card_value(text.substr(10)));
+                }
+            }
+
+            const FitsHeader & header = hdu.header;
+            hdu.bitpix = static_cast<int>(header.integer("BITPIX"));
+            if ((hdu.bitpix != 8) && (hdu.bitpix != 16) && (hdu.bitpix != 32) && (hdu.bitpix != 64) &&
+                (hdu.bitpix != -32) && (hdu.bitpix != -64)) {
+                throw std::runtime_error(fmt::format("Invalid BITPIX {} in HDU {} of {}",
+                                                     hdu.bitpix, this->hdus_.size(), filename));
+            }
+
+            // Size of the data unit is |BITPIX| × GCOUNT × (PCOUNT + NAXIS1 × ... × NAXISn). A negative factor
+            // or a product that wraps around could pass the check that the data are present, so reject both
+            auto factor = [&](const std::string & keyword, std::optional<long long> fallback = std::nullopt) {
+                const long long value = fallback ? header.integer(keyword, *fallback) : header.integer(keyword);
+                if (value < 0) {
+                    throw std::runtime_error(fmt::format("Negative {} {} in HDU {} of {}",
+                                                         keyword, value, this->hdus_.size(), filename));
+                }
+                return static_cast<std::size_t>(value);
+            };
+            auto multiply = [&](std::size_t count, std::size_t value) {
+                constexpr std::size_t Limit = std::numeric_limits<std::size_t>::max() / 8;
+                if ((value != 0) && (count > Limit / value)) {
+                    throw std::runtime_error(fmt::format("Data unit of HDU {} of {} is too large",
+                                                         this->hdus_.size(), filename));
+                }
+                return count * value;
+            };
+
+            const long long axes = static_cast<long long>(factor("NAXIS"));
+            std::size_t count = (axes > 0) ? 1 : 0;
+            for (long long axis = 1; axis <= axes; ++axis) {
+                count = multiply(count, factor(fmt::format("NAXIS{}", axis)));
+            }
+            count = multiply(multiply(1, count + factor("PCOUNT", 0)), factor("GCOUNT", 1));
+            const std::size_t bytes = count * std::abs(hdu.bitpix) / 8;
+
+            hdu.offset = offset;
+            hdu.width = (axes >= 1) ? header.integer("NAXIS1") : 0;
+            hdu.height = (axes >= 2) ? header.integer("NAXIS2") : 1;
+            hdu.bscale = header.number("BSCALE", 1);
+            hdu.bzero = header.number("BZERO", 0);
+            if ((hdu.bitpix > 0) && header.has("BLANK")) {
+                hdu.blank = header.integer("BLANK");
+            }
+            // Only to check that all the data are present, the last block need not be padded
+            static_cast<void>(this->file_.view<char>(offset, bytes));
+
+            this->hdus_.push_back(std::move(hdu));
+            offset += (bytes + BlockSize - 1) / BlockSize * BlockSize;
+        }
+
+        if (this->hdus_.empty()) {
+            throw std::runtime_error(fmt::format("{} is not a FITS file", filename));
+        }
+    }
+
+    const FitsHdu & FitsFile::hdu(std::size_t index) const {
+        if (index >= this->hdus_.size()) {
+            throw std::out_of_range(fmt::format("HDU {} requested, but {} has only {}",
+                                                index, this->filename(), this->hdus_.size()));
+        }
+        return this->hdus_[index];
+    }
+
+    std::size_t FitsFile::first_image() const {
+        for (std::size_t index = 0; index < this->hdus_.size(); ++index) {
+            if (this->hdus_[index].is_image()) {
+                return index;
+            }
+        }
+        throw std::runtime_error(fmt::format("{} contains no image", this->filename()));
+    }
+
+    Matrix FitsFile::matrix(std::size_t index) const {
+        const FitsHdu & hdu = this->hdu(index);
+        Matrix out(hdu.height, hdu.width);
+        this->copy_to(index, out.data());
+        return out;
+    }
+
+    template<class T>
+    void FitsFile::convert(const FitsHdu & hdu, storage * target) const {
+        const std::size_t count = hdu.width * hdu.height;
+        const char * bytes = this->file_.view<char>(hdu.offset, count * sizeof(T));
+
+        if constexpr (std::is_same_v<T, storage>) {
+            // Same type: copy everything at once and swap the bytes in place
+            std::memcpy(target, bytes, count * sizeof(T));
+            swap_in_place(target, count);
+        } else {
+            for (std::size_t i = 0; i < count; ++i) {
+                target[i] = static_cast<storage>(big_endian<T>(bytes + i * sizeof(T)));
+            }
+        }
+
+        if constexpr (std::is_integral_v<T>) {
+            if (!hdu.blank) {
+                return;
+            }
+            const T blank = static_cast<T>(*hdu.blank);
+            for (std::size_t i = 0; i < count; ++i) {
+                if (big_endian<T>(bytes + i * sizeof(T)) == blank) {
+                    target[i] = std::numeric_limits<storage>::quiet_NaN();
+                }
+            }
+        }
+    }
+
+    void FitsFile::copy_to(std::size_t index, storage * target) const {
+        const FitsHdu & hdu = this->hdu(index);
+        if (!hdu.is_image()) {
+            throw std::runtime_error(fmt::format("HDU {} of {} is not an image", index, this->filename()));
+        }
+
+        switch (hdu.bitpix) {
+            case 8: this->convert<std::uint8_t>(hdu, target); break;
+            case 16: this->convert<std::int16_t>(hdu, target); break;
+            case 32: this->convert<std::int32_t>(hdu, target); break;
+            case 64: this->convert<std::int64_t>(hdu, target); break;
+            case -32: this->convert<float>(hdu, target); break;
+            case -64: this->convert<double>(hdu, target); break;
+            default: throw std::runtime_error(fmt::format("Invalid BITPIX {}", hdu.bitpix));
+        }
+
+        if ((hdu.bscale != 1) || (hdu.bzero != 0)) {
+            Eigen::Map<Matrix> out(target, hdu.height, hdu.width);
+            out = (out.array() * static_cast<storage>(hdu.bscale) + static_cast<storage>(hdu.bzero)).matrix();
+        }
+    }
+
+    WcsPlacement FitsFile::placement(std::size_t index, const WcsFrame & frame) const {
+        const FitsHdu & hdu = this->hdu(index);
+        const FitsHeader & header = hdu.header;
+
+        // Linear transformation from pixel offsets to intermediate world coordinates
+        Eigen::Matrix2d linear;
+        if (header.has("CD1_1") || header.has("CD1_2") || header.has("CD2_1") || header.has("CD2_2")) {
+            linear << header.number("CD1_1", 0), header.number("CD1_2", 0),
+                      header.number("CD2_1", 0), header.number("CD2_2", 0);
+        } else {
+            const Eigen::Vector2d delta(header.number("CDELT1", 1), header.number("CDELT2", 1));
+            Eigen::Matrix2d matrix;
+            if (header.has("PC1_1") || header.has("PC1_2") || header.has("PC2_1") || header.has("PC2_2")) {
+                // CDi_j = CDELTi PCi_j, so CDELT scales the rows of PC
+                matrix << header.number("PC1_1", 1), header.number("PC1_2", 0),
+                          header.number("PC2_1", 0), header.number("PC2_2", 1);
+                linear = delta.asDiagonal() * matrix;
+            } else {
+                // The older CROTA2 convention rotates pixel axes already scaled by CDELT
+                const real rho = header.number("CROTA2", 0) * std::numbers::pi / 180.0;
+                matrix << std::cos(rho), -std::sin(rho),
+                          std::sin(rho), std::cos(rho);
+                linear = matrix * delta.asDiagonal();
+            }
+        }
+        if (linear.determinant() == 0) {
+            throw std::runtime_error(fmt::format("Singular WCS in HDU {} of {}", index, this->filename()));
+        }
+
+        // CD and PC already give offsets on the sky, but differences of CRVAL are in RA, so scale them by cos(δ)
+        const bool celestial = header.has("CTYPE2") && is_latitude(header.text("CTYPE2"));
+        const Eigen::Vector2d crpix(header.number("CRPIX1", 0), header.number("CRPIX2", 0));
+        const Eigen::Vector2d crval(header.number("CRVAL1", 0), header.number("CRVAL2", 0));
+        Eigen::Vector2d shift = crval - Eigen::Vector2d(frame.reference.x, frame.reference.y);
+        if (celestial) {
+            shift.x() = std::remainder(shift.x(), 360.0) * std::cos(frame.reference.y * std::numbers::pi / 180.0);
+        }
+
+        // World coordinates of the centre of the image, between pixels (N + 1) / 2 in the 1-based FITS convention
+        const Eigen::Vector2d middle((hdu.width + 1) / 2.0, (hdu.height + 1) / 2.0);
+        const Eigen::Vector2d axes((linear.determinant() < 0) ? -1.0 / frame.scale : 1.0 / frame.scale, 1.0 / frame.scale);
+        const Eigen::Vector2d centre = axes.cwiseProduct(shift + linear * (middle - crpix));
+
+        // What remains must be a rotation of two orthogonal axes with positive pixel sizes
+        const Eigen::Matrix2d world = axes.asDiagonal() * linear;
+        const real pitch_x = world.col(0).norm();
+        const real pitch_y = world.col(1).norm();
+        if (std::abs(world.col(0).dot(world.col(1))) > 1e-6 * pitch_x * pitch_y) {
+            throw std::runtime_error(fmt::format("WCS of HDU {} of {} is skewed, which a placed grid cannot represent",
+                                                 index, this->filename()));
+        }
+
+        return {
+            Point(frame.position.x + centre.x(), frame.position.y + centre.y()),
+            {pitch_x * hdu.width, pitch_y * hdu.height},
+            std::atan2(world(1, 0), world(0, 0)),
+        };
+    }
+
+    std::string fits_card(const std::string & keyword, const std::string & value, const std::string & comment) {
+        std::string card = fmt::format("{:<8}= ", keyword);
+        card += ((!value.empty()) && (value[0] == '\'')) ? fmt::format("{:<20}", value) : fmt::format("{:>20}", value);
+        if (!comment.empty()) {
+            card += " / " + comment;
+        }
+        if (card.size() > FitsFile::CardSize) {
+            throw std::invalid_argument(fmt::format("FITS card for {} is longer than 80 characters", keyword));
+        }
+        card.resize(FitsFile::CardSize, ' ');
+        return card;
+    }
+
+    std::string fits_header(const std::vector<std::string> & cards) {
+        std::string header;
+        for (auto && card: cards) {
+            header += card;
+        }
+        header += fmt::format("{:<80}", "END");
+        header.resize((header.size() + FitsFile::BlockSize - 1) / FitsFile::BlockSize * FitsFile::BlockSize, ' ');
+        return header;
+    }
+
+    int fits_bitpix() {
+        return -8 * static_cast<int>(sizeof(storage));
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef ANASTASIS_CPP_FITS_H
+#define ANASTASIS_CPP_FITS_H
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "types/types.h"
+#include "types/point.h"
+#include "utils/eigen.h"
+#include "utils/mappedfile.h"
+
+namespace Astar {
+    /** Keywords of a single FITS header, values as written without quotes or comments **/
+    class FitsHeader {
+    private:
+        std::map<std::string, std::string> values_;
+    public:
+        void set(const std::string & keyword, const std::string & value);
+
+        [[nodiscard]] bool has(const std::string & keyword) const;
+        /** Value of a keyword, throws if it is missing **/
+        [[nodiscard]] const std::string & text(const std::string & keyword) const;
+        [[nodiscard]] real number(const std::string & keyword) const;
+        [[nodiscard]] real number(const std::string & keyword, real fallback) const;
+        [[nodiscard]] long long integer(const std::string & keyword) const;
+        [[nodiscard]] long long integer(const std::string & keyword, long long fallback) const;
+    };
+
+    /** A single header and data unit, located within the file **/
+    struct FitsHdu {
+        FitsHeader header;
+        int bitpix = 0;
+        Eigen::Index width = 0;             // NAXIS1
+        Eigen::Index height = 0;            // NAXIS2, or 1 for one-dimensional data
+        std::size_t offset = 0;             // Start of the data unit
+        real bscale = 1;
+        real bzero = 0;
+        std::optional<long long> blank;     // Integer value of undefined pixels, read as NaN
+
+        /** Primary or IMAGE extension with one- or two-dimensional data (further axes of length 1) **/
+        [[nodiscard]] bool is_image() const;
+    };
+
+    /** Placement of an image in the world plane, as expected by PlacedGrid **/
+    struct WcsPlacement {
+        Point centre;
+        pair<real> physical_size;
+        real rotation;                      // In radians, counter-clockwise
+    };
+
+    /** How linear WCS coordinates are mapped onto the world plane of the model:
+     *
+     *      world = position + F (CRVAL - reference + CD (pixel - CRPIX)) / scale
+     *
+     *  For celestial axes (CTYPE2 DEC--* or *LAT) the RA difference of CRVAL and the reference is multiplied
+     *  by cos(δ) of the reference, a flat-sky approximation valid for fields of a few degrees. F reverses
+     *  the first axis if the WCS has the usual sky parity (east to the left, negative determinant), which
+     *  a rotation alone cannot represent, so images of the same parity always share a common plane.
+     */
+    struct WcsFrame {
+        Point reference = {0, 0};           // WCS coordinates (e.g. RA and Dec in degrees) of the anchor
+        Point position = {0, 0};            // World position of the anchor
+        real scale = 1;                     // WCS units per unit of world coordinates (model cell)
+    };
+
+    /** Memory-mapped FITS file with all headers parsed once. Primary and IMAGE extension HDUs with BITPIX
+     *  8, 16, 32, 64, -32 or -64 can be read, scaled by BSCALE and BZERO.
+     *
+     *  FITS data are big-endian, so they cannot be used in place; data stored as `storage` are copied into
+     *  the target buffer as a whole and byte-swapped there, anything else is converted in a single pass.
+     *  FITS rows start at the bottom of the image, which matches the row order of Image.
+     */
+    class FitsFile {
+    private:
+        MappedFile file_;
+        std::vector<FitsHdu> hdus_;
+
+        template<class T>
+        void convert(const FitsHdu & hdu, storage * target) const;
+    public:
+        constexpr static std::size_t BlockSize = 2880;
+        constexpr static std::size_t CardSize = 80;
+
+        explicit FitsFile(const std::string & filename);
+
+        [[nodiscard]] const std::string & filename() const { return this->file_.filename(); }
+        [[nodiscard]] std::size_t count() const { return this->hdus_.size(); }
+        [[nodiscard]] const FitsHdu & hdu(std::size_t index) const;
+        /** Index of the first HDU with image data, usually 0 or 1 **/
+        [[nodiscard]] std::size_t first_image() const;
+
+        /** Copy of the data of an image HDU as a row-major matrix **/
+        [[nodiscard]] Matrix matrix(std::size_t index) const;
+        /** Copy into a row-major buffer of height × width values **/
+        void copy_to(std::size_t index, storage * target) const;
+
+        /** Placement of an image HDU in the world, from the linear part of its WCS
+         *  (CRPIX, CRVAL and either CD, PC with CDELT, or CDELT with CROTA2) **/
+        [[nodiscard]] WcsPlacement placement(std::size_t index, const WcsFrame & frame) const;
+    };
+
+    /** A single 80-character header card. Values are written as given, so strings must be quoted,
+     *  and are right-aligned to column 30 (fixed format) unless they are strings. **/
+    std::string fits_card(const std::string & keyword, const std::string & value, const std::string & comment = "");
+
+    /** Header unit of the cards, terminated by END and padded with spaces to whole blocks **/
+    std::string fits_header(const std::vector<std::string> & cards);
+
+    /** BITPIX of `storage` **/
+    int fits_bitpix();
+}
+
+#endif //ANASTASIS_CPP_FITS_H
@@ -5,6 +5,7 @@
 #include <iterator>
 #include <numeric>
 #include <functional>
+#include <cmath>
 
 #include "types/types.h"
 
@@ -83,6 +84,26 @@ std::vector<T> & for_each(std::vector<T> & vec, std::function<void(T)> f) {
     return vec;
 }
 
+/** Compensated (Neumaier) summation: keeps long sums accurate even if the summands are single precision **/
+class CompensatedSum {
+private:
+    real sum_ = 0;
+    real compensation_ = 0;
+public:
+    CompensatedSum & operator+=(real value) {
+        const real total = this->sum_ + value;
+        if (std::abs(this->sum_) >= std::abs(value)) {
+            this->compensation_ += (this->sum_ - total) + value;
+        } else {
+            this->compensation_ += (value - total) + this->sum_;
+        }
+        this->sum_ = total;
+        return *this;
+    }
+
+    [[nodiscard]] real value() const { return this->sum_ + this->compensation_; }
+};
+
 real trim(real value, real lower, real upper);
 void time_function(const std::function<real(void)> & f);
 
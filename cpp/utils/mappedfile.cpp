@@ -0,0 +1,74 @@
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/mappedfile.h"
+
+namespace Astar {
+    MappedFile::MappedFile(const std::string & filename):
+        filename_(filename)
+    {
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("Could not open file {}: {}", filename, std::strerror(errno)));
+        }
+
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::runtime_error(fmt::format("Could not stat file {}: {}", filename, std::strerror(error)));
+        }
+
+        // An empty file cannot be mapped, but there is nothing to read from it anyway
+        this->size_ = static_cast<std::size_t>(status.st_size);
+        if (this->size_ > 0) {
+            void * address = ::mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                const int error = errno;
+                ::close(fd);
+                throw std::runtime_error(fmt::format("Could not map file {}: {}", filename, std::strerror(error)));
+            }
+            this->data_ = static_cast<const std::byte *>(address);
+        }
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        this->release();
+    }
+
+    MappedFile::MappedFile(MappedFile && other) noexcept:
+        filename_(std::move(other.filename_)),
+        data_(other.data_),
+        size_(other.size_)
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile & MappedFile::operator=(MappedFile && other) noexcept {
+        if (this != &other) {
+            this->release();
+            this->filename_ = std::move(other.filename_);
+            this->data_ = other.data_;
+            this->size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    void MappedFile::release() {
+        if (this->data_ != nullptr) {
+            ::munmap(const_cast<std::byte *>(this->data_), this->size_);
+            this->data_ = nullptr;
+            this->size_ = 0;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef ANASTASIS_CPP_MAPPEDFILE_H
+#define ANASTASIS_CPP_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace Astar {
+    /** Read-only memory mapping of a whole file, unmapped when destroyed.
+     *  Movable but not copyable, so that every mapping has exactly one owner.
+     */
+    class MappedFile {
+    private:
+        std::string filename_;
+        const std::byte * data_ = nullptr;
+        std::size_t size_ = 0;
+
+        void release();
+    public:
+        explicit MappedFile(const std::string & filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile & other) = delete;
+        MappedFile & operator=(const MappedFile & other) = delete;
+        MappedFile(MappedFile && other) noexcept;
+        MappedFile & operator=(MappedFile && other) noexcept;
+
+        [[nodiscard]] const std::string & filename() const { return this->filename_; }
+        [[nodiscard]] const std::byte * data() const { return this->data_; }
+        [[nodiscard]] std::size_t size() const { return this->size_; }
+
+        /** View <count> values of type T starting at byte <offset>, throws if they do not fit into the file **/
+        template<class T>
+        [[nodiscard]] const T * view(std::size_t offset, std::size_t count = 1) const;
+    };
+}
+
+#include "utils/mappedfile.tpp"
+
+#endif //ANASTASIS_CPP_MAPPEDFILE_H
@@ -0,0 +1,22 @@
+#ifndef ANASTASIS_CPP_MAPPEDFILE_TPP
+#define ANASTASIS_CPP_MAPPEDFILE_TPP
+
+#include <stdexcept>
+
+#define FMT_HEADER_ONLY
+#include <fmt/format.h>
+
+#include "mappedfile.h"
+
+namespace Astar {
+    template<class T>
+    const T * MappedFile::view(std::size_t offset, std::size_t count) const {
+        if ((offset > this->size_) || (count > (this->size_ - offset) / sizeof(T))) {
+            throw std::runtime_error(fmt::format("File {} is too short: cannot read {} bytes at offset {} of {}",
+                                                 this->filename_, count * sizeof(T), offset, this->size_));
+        }
+        return reinterpret_cast<const T *>(this->data_ + offset);
+    }
+}
+
+#endif //ANASTASIS_CPP_MAPPEDFILE_TPP
@@ -0,0 +1,158 @@
+#include <cstdint>
+#include <cstring>
+
+#include "utils/npy.h"
+
+namespace Astar {
+    namespace {
+        /** Value of a key in the header dictionary, up to the next comma or closing bracket **/
+        std::string header_value(const std::string & header, const std::string & key, const std::string & filename) {
+            const std::size_t position = header.find("'" + key + "'");
+            if (position == std::string::npos) {
+                throw std::runtime_error(fmt::format("Missing key '{}' in the header of {}", key, filename));
+            }
+            std::size_t begin = header.find(':', position) + 1;
+            while ((begin < header.size()) && (header[begin] == ' ')) {
+                ++begin;
+            }
+            const std::size_t end = (header[begin] == '(') ? header.find(')', begin) + 1 : header.find_first_of(",}", begin);
+            return header.substr(begin, end - begin);
+        }
+    }
+
+    NpyArray::NpyArray(const std::string & filename):
+        file_(filename)
+    {
+        const char * magic = this->file_.view<char>(0, 8);
+        if ((static_cast<unsigned char>(magic[0]) != 0x93) || (std::memcmp(magic + 1, "NUMPY", 5) != 0)) {
+            throw std::runtime_error(fmt::format("{} is not an .npy file", filename));
+        }
+
+        // Version 1 stores the header length in two bytes, later versions in four
+        const int major = static_cast<unsigned char>(magic[6]);
+        std::size_t length = 0;
+        if (major == 1) {
+            length = *this->file_.view<std::uint16_t>(8);
+            this->offset_ = 10 + length;
+        } else if ((major == 2) || (major == 3)) {
+            std::uint32_t header_length;
+            std::memcpy(&header_length, this->file_.view<char>(8, 4), sizeof header_length);
+            length = header_length;
+            this->offset_ = 12 + length;
+        } else {
+            throw std::runtime_error(fmt::format("Unsupported .npy version {} in {}", major, filename));
+        }
+        const std::string header(this->file_.view<char>(this->offset_ - length, length), length);
+
+        const std::string descr = header_value(header, "descr", filename);
+        this->descr_ = descr.substr(1, descr.size() - 2);
+        this->fortran_order_ = header_value(header, "fortran_order", filename) == "True";
+
+        // Shapes are (rows, cols) or (length,)
+        const std::string shape = header_value(header, "shape", filename);
+        std::vector<Eigen::Index> dimensions;
+        for (std::size_t i = 1; i < shape.size();) {
+            const std::size_t end = shape.find_first_of(",)", i);
+            const std::string item = shape.substr(i, end - i);
+            if (item.find_first_not_of(' ') != std::string::npos) {
+                dimensions.push_back(std::stoll(item));
+                if (dimensions.back() < 0) {
+                    throw std::runtime_error(fmt::format("Negative dimension in shape {} of {}", shape, filename));
+                }
+            }
+            i = end + 1;
+        }
+        if (dimensions.size() == 2) {
+            this->rows_ = dimensions[0];
+            this->cols_ = dimensions[1];
+        } else if (dimensions.size() == 1) {
+            this->cols_ = dimensions[0];
+        } else {
+            throw std::runtime_error(fmt::format("Only one- and two-dimensional arrays are supported, {} has shape {}",
+                                                 filename, shape));
+        }
+
+        if ((this->descr_.size() < 3) || ((this->descr_[0] != '<') && (this->descr_[0] != '|')) ||
+            (std::string("fiu").find(this->descr_[1]) == std::string::npos)) {
+            throw std::runtime_error(fmt::format("Unsupported data type '{}' in {}", this->descr_, filename));
+        }
+        const std::size_t item = std::stoul(this->descr_.substr(2));
+        // Only to check that all the data are present
+        static_cast<void>(this->file_.view<char>(this->offset_, this->rows_ * this->cols_ * item));
+    }
+
+    Eigen::Map<const Matrix> NpyArray::view() const {
+        if ((this->descr_ != npy_descr()) || this->fortran_order_) {
+            throw std::runtime_error(fmt::format("Cannot view {} in place: stored as {}{}, expected {} in C order",
+                                                 this->filename(), this->descr_,
+                                                 this->fortran_order_ ? " in Fortran order" : "", npy_descr()));
+        }
+        return {this->file_.view<storage>(this->offset_, this->rows_ * this->cols_), this->rows_, this->cols_};
+    }
+
+    Matrix NpyArray::matrix() const {
+        Matrix out(this->rows_, this->cols_);
+        this->copy_to(out.data());
+        return out;
+    }
+
+    template<class T>
+    void NpyArray::convert(storage * target) const {
+        // The data need not be aligned for T, so map them as bytes and copy them as a whole first if needed
+        typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Source;
+        const auto * bytes = this->file_.view<char>(this->offset_, this->rows_ * this->cols_ * sizeof(T));
+        Source source(this->fortran_order_ ? this->cols_ : this->rows_, this->fortran_order_ ? this->rows_ : this->cols_);
+        std::memcpy(source.data(), bytes, source.size() * sizeof(T));
+
+        Eigen::Map<Matrix> out(target, this->rows_, this->cols_);
+        if (this->fortran_order_) {
+            out = source.transpose().template cast<storage>();
+        } else {
+            out = source.template cast<storage>();
+        }
+    }
+
+    void NpyArray::copy_to(storage * target) const {
+        const std::size_t count = this->rows_ * this->cols_;
+        if ((this->descr_ == npy_descr()) && !this->fortran_order_) {
+            std::memcpy(target, this->file_.view<storage>(this->offset_, count), count * sizeof(storage));
+            return;
+        }
+
+        const char kind = this->descr_[1];
+        const int size = std::stoi(this->descr_.substr(2));
+        if ((kind == 'f') && (size == 8)) {
+            this->convert<double>(target);
+        } else if ((kind == 'f') && (size == 4)) {
+            this->convert<float>(target);
+        } else if ((kind == 'i') && (size == 4)) {
+            this->convert<std::int32_t>(target);
+        } else if ((kind == 'i') && (size == 8)) {
+            this->convert<std::int64_t>(target);
+        } else if ((kind == 'u') && (size == 1)) {
+            this->convert<std::uint8_t>(target);
+        } else if ((kind == 'u') && (size == 2)) {
+            this->convert<std::uint16_t>(target);
+        } else {
+            throw std::runtime_error(fmt::format("Unsupported data type '{}' in {}", this->descr_, this->filename()));
+        }
+    }
+
+    std::string npy_header(const std::string & descr, bool fortran_order, Eigen::Index rows, Eigen::Index cols) {
+        std::string header("\x93NUMPY\x01\x00", 8);
+        const std::string dictionary = fmt::format("{{'descr': '{}', 'fortran_order': {}, 'shape': ({}, {})}}",
+                                                   descr, fortran_order ? "True" : "False", rows, cols);
+        // The whole header must be a multiple of 64 bytes long, padded with spaces and terminated by a newline
+        const std::size_t length = (10 + dictionary.size() + 1 + 63) / 64 * 64 - 10;
+        header.push_back(static_cast<char>(length & 0xFF));
+        header.push_back(static_cast<char>(length >> 8));
+        header += dictionary;
+        header.append(length - dictionary.size() - 1, ' ');
+        header.push_back('\n');
+        return header;
+    }
+
+    std::string npy_descr() {
+        return fmt::format("<f{}", sizeof(storage));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef ANASTASIS_CPP_NPY_H
+#define ANASTASIS_CPP_NPY_H
+
+#include <string>
+
+#include "utils/eigen.h"
+#include "utils/mappedfile.h"
+
+namespace Astar {
+    /** Memory-mapped two-dimensional NumPy array (.npy, format versions 1 to 3), with the header parsed once.
+     *  One-dimensional arrays are read as a single row. Little-endian floats and integers are supported.
+     *
+     *  Arrays whose type and order match what is asked for can be viewed in place without copying,
+     *  anything else is converted in a single pass.
+     */
+    class NpyArray {
+    private:
+        MappedFile file_;
+        std::string descr_;
+        bool fortran_order_ = false;
+        Eigen::Index rows_ = 1;
+        Eigen::Index cols_ = 1;
+        std::size_t offset_ = 0;        // Start of the data
+
+        template<class T>
+        void convert(storage * target) const;
+    public:
+        explicit NpyArray(const std::string & filename);
+
+        [[nodiscard]] const std::string & filename() const { return this->file_.filename(); }
+        [[nodiscard]] const std::string & descr() const { return this->descr_; }
+        [[nodiscard]] bool fortran_order() const { return this->fortran_order_; }
+        [[nodiscard]] Eigen::Index rows() const { return this->rows_; }
+        [[nodiscard]] Eigen::Index cols() const { return this->cols_; }
+
+        /** Zero-copy row-major view of the data, valid while the array exists.
+         *  Throws unless the data are stored as `storage` in C order. **/
+        [[nodiscard]] Eigen::Map<const Matrix> view() const;
+        /** Copy of the data in any supported type and order, converted to a row-major matrix **/
+        [[nodiscard]] Matrix matrix() const;
+        /** Copy into a row-major buffer of rows × cols values **/
+        void copy_to(storage * target) const;
+    };
+
+    /** Header of an .npy file (version 1.0) describing a rows × cols array, padded to a multiple of 64 bytes **/
+    std::string npy_header(const std::string & descr, bool fortran_order, Eigen::Index rows, Eigen::Index cols);
+
+    /** NumPy type descriptor of `storage` **/
+    std::string npy_descr();
+}
+
+#endif //ANASTASIS_CPP_NPY_H
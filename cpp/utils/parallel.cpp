@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "utils/parallel.h"
+
+namespace Astar {
+    int resolve_threads(int requested) {
+        if (requested > 0) {
+            return requested;
+        }
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    void parallel_for(int begin, int end, int threads, const std::function<void(int, int, int)> & body) {
+        const int length = std::max(0, end - begin);
+        const int blocks = std::max(1, std::min(resolve_threads(threads), length));
+
+        if (blocks == 1) {
+            body(0, begin, end);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(blocks);
+        workers.reserve(blocks - 1);
+
+        // Distribute the remainder over the first few blocks so that sizes differ by at most one
+        auto block_begin = [&](int block) {
+            return begin + block * (length / blocks) + std::min(block, length % blocks);
+        };
+
+        for (int block = 1; block < blocks; ++block) {
+            workers.emplace_back([&, block] {
+                try {
+                    body(block, block_begin(block), block_begin(block + 1));
+                } catch (...) {
+                    errors[block] = std::current_exception();
+                }
+            });
+        }
+
+        try {
+            body(0, block_begin(0), block_begin(1));
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+
+        for (auto && worker: workers) {
+            worker.join();
+        }
+        for (auto && error: errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef ANASTASIS_CPP_PARALLEL_H
+#define ANASTASIS_CPP_PARALLEL_H
+
+#include <functional>
+
+namespace Astar {
+    /** Resolve a requested thread count: anything below 1 means "as many as the hardware offers" **/
+    int resolve_threads(int requested);
+
+    /** Split the range [begin, end) into at most <threads> contiguous blocks and run
+     *  body(thread, block_begin, block_end) for each of them concurrently.
+     *  Blocks are handed out in order, so thread 0 always gets the lowest indices.
+     *  The calling thread processes block 0 itself; exceptions from workers are rethrown here.
+     */
+    void parallel_for(int begin, int end, int threads, const std::function<void(int, int, int)> & body);
+}
+
+#endif //ANASTASIS_CPP_PARALLEL_H